@@ -0,0 +1,226 @@
+//
+// exo
+// BarnesHut.cpp - Barnes-Hut octree gravity solver.
+//
+#include <cmath>
+#include "BarnesHut.hpp"
+#include "Physics.hpp"
+
+static const uint32_t LEAF_SIZE = 8;
+static const std::size_t GRAIN = 64;
+
+template <typename T>
+BarnesHut<T>::BarnesHut(double theta, bool quadrupole)
+: theta_(theta)
+, quadrupole_(quadrupole)
+, tree_(LEAF_SIZE) {
+}
+
+// Adds the quadrupole contribution of a point mass, or of a child cell's
+// centre of mass, to a cell whose centre of mass is already known.
+template <typename T>
+void BarnesHut<T>::addQuadrupole(Moments& moments, W mass, W x, W y, W z) {
+    W dx = x - moments.cx;
+    W dy = y - moments.cy;
+    W dz = z - moments.cz;
+    W d2 = dx*dx + dy*dy + dz*dz;
+    
+    moments.qxx += mass * (3*dx*dx - d2);
+    moments.qxy += mass * (3*dx*dy);
+    moments.qxz += mass * (3*dx*dz);
+    moments.qyy += mass * (3*dy*dy - d2);
+    moments.qyz += mass * (3*dy*dz);
+    moments.qzz += mass * (3*dz*dz - d2);
+}
+
+template <typename T>
+void BarnesHut<T>::computeMoments() {
+    const auto& cells = tree_.cells();
+    moments_.assign(cells.size(), Moments{});
+    
+    // Children are stored after their parent, so a backward sweep sees every
+    // cell's children before the cell itself.
+    for(auto c = cells.size(); c-- > 0;) {
+        const auto& cell = cells[c];
+        auto& m = moments_[c];
+        
+        if(cell.leaf) {
+            for(auto k = cell.begin; k < cell.end; ++k) {
+                m.mass += tree_.mass[k];
+                m.cx += W(tree_.mass[k]) * tree_.x[k];
+                m.cy += W(tree_.mass[k]) * tree_.y[k];
+                m.cz += W(tree_.mass[k]) * tree_.z[k];
+            }
+        } else {
+            for(auto child = c + 1; child < cell.next; child = cells[child].next) {
+                const auto& cm = moments_[child];
+                m.mass += cm.mass;
+                m.cx += cm.mass * cm.cx;
+                m.cy += cm.mass * cm.cy;
+                m.cz += cm.mass * cm.cz;
+            }
+        }
+        
+        // Cells with no mass are given their geometric centre, so that they
+        // are still well-formed.
+        if(m.mass > 0) {
+            m.cx /= m.mass;
+            m.cy /= m.mass;
+            m.cz /= m.mass;
+        } else {
+            m.cx = cell.x;
+            m.cy = cell.y;
+            m.cz = cell.z;
+        }
+        
+        if(cell.leaf) {
+            for(auto k = cell.begin; k < cell.end; ++k) {
+                addQuadrupole(m, tree_.mass[k], tree_.x[k], tree_.y[k], tree_.z[k]);
+            }
+        } else {
+            for(auto child = c + 1; child < cell.next; child = cells[child].next) {
+                const auto& cm = moments_[child];
+                m.qxx += cm.qxx;
+                m.qxy += cm.qxy;
+                m.qxz += cm.qxz;
+                m.qyy += cm.qyy;
+                m.qyz += cm.qyz;
+                m.qzz += cm.qzz;
+                addQuadrupole(m, cm.mass, cm.cx, cm.cy, cm.cz);
+            }
+        }
+        
+        // Cells whose centre of mass sits off-centre are opened from further
+        // away (Barnes' offset criterion), which bounds the worst-case error.
+        W offset = std::sqrt((m.cx - cell.x) * (m.cx - cell.x)
+                           + (m.cy - cell.y) * (m.cy - cell.y)
+                           + (m.cz - cell.z) * (m.cz - cell.z));
+        m.open = 2 * cell.half + theta_ * offset;
+    }
+}
+
+template <typename T>
+void BarnesHut<T>::walk(uint32_t k, W& ax, W& ay, W& az) const {
+    const W G = Physics::G;
+    const auto& cells = tree_.cells();
+    const auto* x = tree_.x.data();
+    const auto* y = tree_.y.data();
+    const auto* z = tree_.z.data();
+    const auto* mass = tree_.mass.data();
+    const W theta = theta_;
+    const uint32_t cellCount = cells.size();
+    const W px = x[k], py = y[k], pz = z[k];
+    ax = 0;
+    ay = 0;
+    az = 0;
+    
+    uint32_t c = 0;
+    while(c < cellCount) {
+        const auto& cell = cells[c];
+        const auto& m = moments_[c];
+        W dx = m.cx - px;
+        W dy = m.cy - py;
+        W dz = m.cz - pz;
+        W r2 = dx*dx + dy*dy + dz*dz;
+        
+        // Never accept a cell that contains the body itself.
+        bool inside = std::abs(px - cell.x) <= cell.half
+                   && std::abs(py - cell.y) <= cell.half
+                   && std::abs(pz - cell.z) <= cell.half;
+        
+        if(!inside && m.open < theta * std::sqrt(r2)) {
+            W invR = 1 / std::sqrt(r2);
+            W invR2 = invR * invR;
+            W invR3 = G * invR * invR2;
+            
+            ax += m.mass * invR3 * dx;
+            ay += m.mass * invR3 * dy;
+            az += m.mass * invR3 * dz;
+            
+            if(quadrupole_) {
+                // With r pointing from the centre of mass to the body:
+                //   a = G (Q.r / r^5 - 5/2 (r.Q.r) r / r^7)
+                W qx = -(m.qxx*dx + m.qxy*dy + m.qxz*dz);
+                W qy = -(m.qxy*dx + m.qyy*dy + m.qyz*dz);
+                W qz = -(m.qxz*dx + m.qyz*dy + m.qzz*dz);
+                W rqr = -(qx*dx + qy*dy + qz*dz);
+                W invR5 = invR3 * invR2;
+                W invR7 = invR5 * invR2;
+                
+                ax += qx * invR5 + 2.5 * rqr * dx * invR7;
+                ay += qy * invR5 + 2.5 * rqr * dy * invR7;
+                az += qz * invR5 + 2.5 * rqr * dz * invR7;
+            }
+            c = cell.next;
+        } else if(cell.leaf) {
+            for(uint32_t j = cell.begin; j < cell.end; ++j) {
+                if(j == k || mass[j] == 0) { continue; }
+                W ddx = W(x[j]) - px;
+                W ddy = W(y[j]) - py;
+                W ddz = W(z[j]) - pz;
+                W invR = 1 / std::sqrt(ddx*ddx + ddy*ddy + ddz*ddz);
+                W invR3 = G * mass[j] * invR * invR * invR;
+                ax += invR3 * ddx;
+                ay += invR3 * ddy;
+                az += invR3 * ddz;
+            }
+            c = cell.next;
+        } else {
+            c += 1;
+        }
+    }
+}
+
+template <typename T>
+void BarnesHut<T>::accelerate(Particles<T>& particles, ThreadPool& pool) {
+    const uint32_t count = particles.size();
+    if(count == 0) { return; }
+    
+    tree_.build(particles);
+    computeMoments();
+    
+    const auto& order = tree_.order();
+    
+    // Bodies are walked in tree order, so each thread works on a compact
+    // region of space and neighbouring bodies open the same cells.
+    pool.run(count, GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+        for(auto k = begin; k < end; ++k) {
+            W ax, ay, az;
+            walk(k, ax, ay, az);
+            
+            auto i = order[k];
+            particles.ax[i] = ax;
+            particles.ay[i] = ay;
+            particles.az[i] = az;
+        }
+    });
+}
+
+template <typename T>
+void BarnesHut<T>::accelerateSubset(Particles<T>& particles, const std::vector<uint32_t>& active, ThreadPool& pool) {
+    const uint32_t count = particles.size();
+    if(count == 0 || active.empty()) { return; }
+    
+    tree_.build(particles);
+    computeMoments();
+    
+    const auto& order = tree_.order();
+    slot_.resize(count);
+    for(uint32_t k = 0; k < count; ++k) {
+        slot_[order[k]] = k;
+    }
+    
+    pool.run(active.size(), GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+        for(auto a = begin; a < end; ++a) {
+            auto i = active[a];
+            W ax, ay, az;
+            walk(slot_[i], ax, ay, az);
+            particles.ax[i] = ax;
+            particles.ay[i] = ay;
+            particles.az[i] = az;
+        }
+    });
+}
+
+#define INSTANTIATE(T) template class BarnesHut<T>;
+EXO_INSTANTIATE_SCALARS(INSTANTIATE)
@@ -0,0 +1,53 @@
+//
+// exo
+// BarnesHut.hpp - Barnes-Hut octree gravity solver.
+//
+// The octree is rebuilt from the body positions on every force pass. A cell
+// that looks smaller than the opening angle theta from a body acts on it
+// through its monopole (and optionally quadrupole) moment instead of body by
+// body, which brings a force pass down to O(N log N).
+//
+#pragma once
+#include <vector>
+#include "Gravity.hpp"
+#include "Octree.hpp"
+
+template <typename T>
+class BarnesHut : public Gravity<T> {
+public:
+    
+    BarnesHut(double theta, bool quadrupole);
+    
+    void accelerate(Particles<T>& particles, ThreadPool& pool) override;
+    
+    // Builds the tree from every body, and only walks it for the listed ones.
+    void accelerateSubset(Particles<T>& particles, const std::vector<uint32_t>& active, ThreadPool& pool) override;
+    
+private:
+    
+    // Moments are kept in at least double, as mass times distance squared
+    // overflows a float.
+    typedef Scalar::Wide<T> W;
+    
+    // Mass moments of an octree cell.
+    struct Moments {
+        W           mass;
+        W           cx, cy, cz;         // centre of mass
+        W           qxx, qxy, qxz,      // traceless quadrupole tensor about
+                    qyy, qyz, qzz;      // the centre of mass
+        W           open;               // size used by the opening test
+    };
+    
+    void computeMoments();
+    
+    // Sums the pulls on the body at tree index k, walking down from the root.
+    void walk(uint32_t k, W& ax, W& ay, W& az) const;
+    
+    static void addQuadrupole(Moments& moments, W mass, W x, W y, W z);
+    
+    double                      theta_;
+    bool                        quadrupole_;
+    Octree<T>                   tree_;
+    std::vector<Moments>        moments_;
+    std::vector<uint32_t>       slot_;      // tree index of every body
+};
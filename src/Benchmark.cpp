@@ -0,0 +1,882 @@
+//
+// exo
+// Benchmark.cpp - Headless performance measurements.
+//
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <initializer_list>
+#include <iomanip>
+#include <random>
+#include "Benchmark.hpp"
+#include "Elements.hpp"
+#include "Gravity.hpp"
+#include "Orbit.hpp"
+#include "Parareal.hpp"
+#include "Physics.hpp"
+#include "Simd.hpp"
+#include "StarSystem.hpp"
+#include "ThreadPool.hpp"
+
+namespace Benchmark {
+    
+    typedef std::chrono::steady_clock Clock;
+    
+    // Minimum wall time spent on each measurement.
+    static const double MIN_SECONDS = 0.5;
+    
+    // Calls job until at least MIN_SECONDS have passed and returns the mean
+    // time of one call, in seconds.
+    template <typename Job>
+    static double time(Job job) {
+        std::size_t runs = 0;
+        auto start = Clock::now();
+        double elapsed = 0;
+        do {
+            job();
+            ++runs;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while(elapsed < MIN_SECONDS);
+        return elapsed / runs;
+    }
+    
+    // A cloud of sun-like stars a few AU across.
+    static Particles<long double> cloud(std::size_t count) {
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> position(-Physics::AU, Physics::AU);
+        std::uniform_real_distribution<double> mass(0.5e30, 2e30);
+        
+        Particles<long double> particles;
+        for(std::size_t i = 0; i < count; ++i) {
+            Integrator::State<long double> state;
+            state.position = Vector3{position(rng), position(rng), position(rng)};
+            particles.push_back(state, mass(rng));
+        }
+        return particles;
+    }
+    
+    template <typename T>
+    static void simdRows(const Particles<long double>& particles, const Particles<long double>& reference, const char* precision, std::ostream& out) {
+        const auto count = particles.size();
+        const auto padded = (count + Simd::PADDING - 1) / Simd::PADDING * Simd::PADDING;
+        std::vector<T> x(padded, 0), y(padded, 0), z(padded, 0), gm(padded, 0);
+        std::vector<T> ax(padded), ay(padded), az(padded);
+        for(std::size_t i = 0; i < count; ++i) {
+            x[i] = particles.x[i];
+            y[i] = particles.y[i];
+            z[i] = particles.z[i];
+            gm[i] = Physics::G * particles.mass[i];
+        }
+        
+        for(auto isa : {Simd::Isa::SCALAR, Simd::Isa::SSE2, Simd::Isa::AVX2, Simd::Isa::AVX512}) {
+            out << std::setw(8) << Simd::name(isa) << std::setw(8) << precision;
+            if(!Simd::supported(isa)) {
+                out << std::setw(16) << "unsupported" << std::endl;
+                continue;
+            }
+            
+            auto kernel = Simd::kernel<T>(isa);
+            double seconds = time([&] {
+                kernel(x.data(), y.data(), z.data(), gm.data(), padded, 0, count, ax.data(), ay.data(), az.data());
+            });
+            
+            double error = 0;
+            for(std::size_t i = 0; i < count; ++i) {
+                long double ex = ax[i] - reference.ax[i];
+                long double ey = ay[i] - reference.ay[i];
+                long double ez = az[i] - reference.az[i];
+                long double norm = reference.acceleration(i).magnitude();
+                error = std::max<double>(error, std::sqrt(ex*ex + ey*ey + ez*ez) / norm);
+            }
+            out << std::setw(16) << count * (count - 1) / seconds
+                << std::setw(14) << error << std::endl;
+        }
+    }
+    
+    // Interactions per second of every SIMD kernel on one thread, against the
+    // long double direct sum, along with the largest relative error.
+    static void simd(std::ostream& out) {
+        const std::size_t COUNT = 4096;
+        auto particles = cloud(COUNT);
+        auto reference = particles;
+        
+        ThreadPool pool(1);
+        DirectSum<long double> direct;
+        double seconds = time([&] { direct.accelerate(reference, pool); });
+        
+        out << "simd direct sum, " << COUNT << " bodies, one thread" << std::endl;
+        out << std::setw(8) << "isa" << std::setw(8) << "type"
+            << std::setw(16) << "interactions/s" << std::setw(14) << "max error" << std::endl;
+        out << std::setw(8) << "x87" << std::setw(8) << "long"
+            << std::setw(16) << COUNT * (COUNT - 1) / seconds << std::setw(14) << 0.0 << std::endl;
+        simdRows<double>(particles, reference, "double", out);
+        simdRows<float>(particles, reference, "float", out);
+        out << "best: " << Simd::name(Simd::best()) << std::endl;
+    }
+    
+    // MARK: - Precision
+    
+    // Total energy of a set of bodies, summed in long double.
+    template <typename T>
+    static long double energy(const Particles<T>& particles) {
+        long double e = 0;
+        for(std::size_t i = 0; i < particles.size(); ++i) {
+            vec3<long double> v = particles.velocity(i);
+            vec3<long double> p = particles.position(i);
+            e += 0.5L * particles.mass[i] * vec3<long double>::dot(v, v);
+            for(std::size_t j = i + 1; j < particles.size(); ++j) {
+                vec3<long double> d = p - vec3<long double>(particles.position(j));
+                e -= Physics::G * particles.mass[i] * particles.mass[j] / d.magnitude();
+            }
+        }
+        return e;
+    }
+    
+    struct Trajectory {
+        double                          seconds;
+        long double                     drift;      // relative energy error
+        std::vector<vec3<long double>>  positions;  // at the end of the run
+    };
+    
+    static const int PRECISION_STEPS = 50000;
+    static const double PRECISION_STEP = 60;
+    
+    template <typename T>
+    static Trajectory trajectory(const std::string& path, bool compensated = false) {
+        std::ifstream in{path};
+        Integrator::Config config;
+        config.compensated = compensated;
+        StarSystem<T> system{in, Physics::J2000,
+                             Gravity<T>::named("direct", GravityConfig{}),
+                             Integrator::Scheme<T>::named("verlet", config), 1};
+        
+        Trajectory result;
+        auto e0 = energy(system.particles());
+        auto start = Clock::now();
+        system.advance(PRECISION_STEPS, PRECISION_STEP);
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.drift = (energy(system.particles()) - e0) / e0;
+        
+        const auto& particles = system.particles();
+        for(std::size_t i = 0; i < particles.size(); ++i) {
+            result.positions.push_back(particles.position(i));
+        }
+        return result;
+    }
+    
+    // Steps per second and energy drift of the direct-sum Verlet integrator
+    // in every precision, with and without compensated updates for double,
+    // and how far the bodies end up from where the most precise run puts them.
+    static void precision(const std::vector<std::string>& files, std::ostream& out) {
+        for(const auto& path : files) {
+            if(!std::ifstream{path}.is_open()) {
+                out << path << ": cannot open file" << std::endl;
+                continue;
+            }
+            
+            std::vector<std::pair<const char*, Trajectory>> runs;
+            runs.push_back(std::make_pair(Scalar::name<float>(), trajectory<float>(path)));
+            runs.push_back(std::make_pair(Scalar::name<double>(), trajectory<double>(path)));
+            runs.push_back(std::make_pair("double+c", trajectory<double>(path, true)));
+            runs.push_back(std::make_pair(Scalar::name<long double>(), trajectory<long double>(path)));
+#ifdef EXO_QUAD
+            runs.push_back(std::make_pair(Scalar::name<__float128>(), trajectory<__float128>(path)));
+#endif
+            const auto& reference = runs.back().second.positions;
+            
+            out << path << ", " << PRECISION_STEPS << " steps of " << PRECISION_STEP << "s" << std::endl;
+            out << std::setw(8) << "type" << std::setw(14) << "steps/s"
+                << std::setw(14) << "energy error" << std::setw(18) << "position error" << std::endl;
+            for(const auto& run : runs) {
+                long double error = 0;
+                for(std::size_t i = 0; i < reference.size(); ++i) {
+                    error = std::max(error, (run.second.positions[i] - reference[i]).magnitude());
+                }
+                out << std::setw(8) << run.first
+                    << std::setw(14) << PRECISION_STEPS / run.second.seconds
+                    << std::setw(14) << run.second.drift
+                    << std::setw(16) << error << " m" << std::endl;
+            }
+        }
+    }
+    
+    // MARK: - Schemes
+    
+    // Schemes compared, and the step sizes they are run at. Adaptive schemes
+    // take the step size as their longest step.
+    static const char* const SCHEMES[] = {
+        "verlet", "block", "hermite", "hermite-block", "forest-ruth", "yoshida4", "yoshida6", "yoshida8", "wh", "hybrid", "ias15", "bs"
+    };
+    static const double SCHEME_STEPS[] = {60, 600, 3600, 21600};
+    
+    static const double SCHEME_SPAN = 100 * 86400.0;
+    static const int SCHEME_SAMPLES = 100;
+    
+    struct Run {
+        double          seconds;
+        long double     drift;      // largest relative energy error
+    };
+    
+    static Run integrate(const std::string& path, const std::string& scheme, double step) {
+        std::ifstream in{path};
+        StarSystem<long double> system{in, Physics::J2000,
+                                       Gravity<long double>::named("direct", GravityConfig{}),
+                                       Integrator::Scheme<long double>::named(scheme, Integrator::Config{}), 1};
+        
+        Run result{0, 0};
+        auto e0 = energy(system.particles());
+        int steps = std::lround(SCHEME_SPAN / step / SCHEME_SAMPLES);
+        for(int sample = 0; sample < SCHEME_SAMPLES; ++sample) {
+            auto start = Clock::now();
+            system.advance(steps, step);
+            result.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+            result.drift = std::max(result.drift, std::abs((energy(system.particles()) - e0) / e0));
+        }
+        return result;
+    }
+    
+    // Wall time and largest energy error of every integration scheme
+    // over the same span at a range of step sizes, in long double with the
+    // direct sum, so schemes can be compared at equal accuracy.
+    static void schemes(const std::vector<std::string>& files, std::ostream& out) {
+        for(const auto& path : files) {
+            if(!std::ifstream{path}.is_open()) {
+                out << path << ": cannot open file" << std::endl;
+                continue;
+            }
+            
+            out << path << ", " << SCHEME_SPAN / 86400 << " days" << std::endl;
+            out << std::setw(12) << "scheme" << std::setw(10) << "step (s)"
+                << std::setw(14) << "wall time (s)" << std::setw(14) << "energy error" << std::endl;
+            for(auto scheme : SCHEMES) {
+                for(auto step : SCHEME_STEPS) {
+                    auto run = integrate(path, scheme, step);
+                    out << std::setw(12) << scheme << std::setw(10) << step
+                        << std::setw(14) << run.seconds
+                        << std::setw(14) << run.drift << std::endl;
+                }
+            }
+        }
+    }
+    
+    // Relative energy error the accuracy benchmark asks for, and the longest
+    // step it tries.
+    static const long double ACCURACY_TARGET = 1e-9;
+    static const double ACCURACY_STEP = 86400;
+    static const int ACCURACY_HALVINGS = 16;
+    
+    // Wall time every scheme needs to cover the span of the schemes benchmark
+    // within a fixed energy error, at the longest step that keeps it there.
+    // Steps are halved from ACCURACY_STEP until the error is small enough.
+    static void accuracy(const std::vector<std::string>& files, std::ostream& out) {
+        for(const auto& path : files) {
+            if(!std::ifstream{path}.is_open()) {
+                out << path << ": cannot open file" << std::endl;
+                continue;
+            }
+            
+            out << path << ", " << SCHEME_SPAN / 86400 << " days, energy error below "
+                << ACCURACY_TARGET << std::endl;
+            out << std::setw(12) << "scheme" << std::setw(10) << "step (s)"
+                << std::setw(14) << "wall time (s)" << std::setw(14) << "energy error" << std::endl;
+            for(auto scheme : SCHEMES) {
+                double step = ACCURACY_STEP;
+                auto run = integrate(path, scheme, step);
+                for(int i = 0; i < ACCURACY_HALVINGS && !(run.drift <= ACCURACY_TARGET); ++i) {
+                    step /= 2;
+                    run = integrate(path, scheme, step);
+                }
+                out << std::setw(12) << scheme << std::setw(10) << step
+                    << std::setw(14) << run.seconds << std::setw(14) << run.drift;
+                if(!(run.drift <= ACCURACY_TARGET)) {
+                    out << " (not reached)";
+                }
+                out << std::endl;
+            }
+        }
+    }
+    
+    // MARK: - Debris disk
+    
+    static const std::size_t DISK_BODIES = 500;
+    static const double DISK_SPAN = 10 * 365.25 * 86400;
+    
+    // A sun-like star with a disk of asteroids on circular orbits, spread
+    // evenly in distance from 1 to 50 AU, so that most of them are far out
+    // and slow.
+    static Particles<double> disk(std::size_t count) {
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> distance(1, 50);
+        std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+        
+        Particles<double> particles;
+        Integrator::State<double> star;
+        particles.push_back(star, Physics::Msol);
+        for(std::size_t i = 1; i < count; ++i) {
+            double r = distance(rng) * Physics::AU;
+            double phi = angle(rng);
+            double v = std::sqrt(Physics::G * Physics::Msol / r);
+            Integrator::State<double> state;
+            state.position = vec3<double>{r * std::cos(phi), r * std::sin(phi), 0};
+            state.velocity = vec3<double>{-v * std::sin(phi), v * std::cos(phi), 0};
+            particles.push_back(state, 1e18);
+        }
+        return particles;
+    }
+    
+    // Wall time and energy error over ten years of a debris disk, with every
+    // body stepping together at the step the innermost ones need, and with
+    // adaptive and block timesteps up to 256 times longer.
+    static void debris(std::ostream& out) {
+        ThreadPool pool(0);
+        auto gravity = Gravity<double>::named("direct", GravityConfig{});
+        Integrator::Forces<double> forces{*gravity, pool};
+        
+        out << "debris disk, " << DISK_BODIES << " bodies, " << DISK_SPAN / 86400 << " days, double" << std::endl;
+        out << std::setw(14) << "scheme" << std::setw(10) << "step (s)"
+            << std::setw(14) << "wall time (s)" << std::setw(14) << "energy error" << std::endl;
+        
+        std::pair<const char*, double> runs[] = {
+            {"verlet", 43200}, {"block", 256 * 43200},
+            {"hermite", 256 * 43200}, {"hermite-block", 256 * 43200}
+        };
+        for(const auto& run : runs) {
+            auto particles = disk(DISK_BODIES);
+            auto scheme = Integrator::Scheme<double>::named(run.first, Integrator::Config{});
+            forces(particles);
+            scheme->start(particles, forces);
+            
+            auto e0 = energy(particles);
+            auto start = Clock::now();
+            for(double t = 0; t < DISK_SPAN;) {
+                t += scheme->step(particles, forces, run.second);
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            out << std::setw(14) << run.first << std::setw(10) << run.second
+                << std::setw(14) << seconds << std::setw(14) << (energy(particles) - e0) / e0 << std::endl;
+        }
+    }
+    
+    // MARK: - Test particles
+    
+    static const std::size_t MASSLESS_COUNTS[] = {1000, 4000, 16000};
+    
+    // Time of a force pass over a debris disk with every asteroid pulling on
+    // the others, and with the asteroids as test particles, so that only the
+    // star is a source.
+    static void massless(std::ostream& out) {
+        ThreadPool pool(0);
+        out << "debris disk force pass, " << pool.size() << " threads, double" << std::endl;
+        out << std::setw(8) << "bodies" << std::setw(8) << "solver"
+            << std::setw(16) << "massive (ms)" << std::setw(16) << "massless (ms)" << std::endl;
+        for(auto count : MASSLESS_COUNTS) {
+            for(auto name : {"direct", "simd"}) {
+                auto gravity = Gravity<double>::named(name, GravityConfig{});
+                auto particles = disk(count);
+                double massive = time([&] { gravity->accelerate(particles, pool); });
+                std::fill(particles.mass.begin() + 1, particles.mass.end(), 0.0);
+                double tests = time([&] { gravity->accelerate(particles, pool); });
+                out << std::setw(8) << count << std::setw(8) << name
+                    << std::setw(16) << massive * 1e3 << std::setw(16) << tests * 1e3 << std::endl;
+            }
+        }
+    }
+    
+    // MARK: - Binary planet
+    
+    static const double BINARY_SPAN = 365.25 * 86400;
+    static const double BINARY_SEPARATION = 5e7;
+    static const double BINARY_STEPS[] = {600, 3600, 21600};
+    static const double HOT_DISTANCE = 0.05;
+    
+    // A sun-like star with two earths circling each other BINARY_SEPARATION
+    // apart, in less than a day, while their centre of mass circles the star
+    // at 1 AU.
+    static Particles<long double> binary() {
+        const long double m = Physics::Mearth;
+        const long double v = std::sqrt(Physics::G * (Physics::Msol + 2 * m) / Physics::AU);
+        const long double w = std::sqrt(Physics::G * 2 * m / BINARY_SEPARATION);
+        
+        Particles<long double> particles;
+        Integrator::State<long double> state;
+        state.velocity = Vector3{0, -2 * m * v / Physics::Msol, 0};
+        particles.push_back(state, Physics::Msol);
+        for(int side : {1, -1}) {
+            state.position = Vector3{Physics::AU + side * BINARY_SEPARATION / 2, 0, 0};
+            state.velocity = Vector3{0, v + side * w / 2, 0};
+            particles.push_back(state, m);
+        }
+        return particles;
+    }
+    
+    // A sun-like star with an earth at HOT_DISTANCE, whose orbit of a few
+    // days is short next to the longer steps, and a jupiter at 5 AU. The
+    // regularised pair is the star and the inner planet, which a
+    // heliocentric scheme must leave to its own drifts.
+    static Particles<long double> hotPlanet() {
+        const long double distance[] = {HOT_DISTANCE, 5};
+        const long double mass[] = {Physics::Mearth, 317.8 * Physics::Mearth};
+        
+        Particles<long double> particles;
+        Integrator::State<long double> state;
+        long double momentum = 0;
+        particles.push_back(state, Physics::Msol);
+        for(int k = 0; k < 2; ++k) {
+            long double v = std::sqrt(Physics::G * (Physics::Msol + mass[k]) / (distance[k] * Physics::AU));
+            state.position = Vector3{distance[k] * Physics::AU, 0, 0};
+            state.velocity = Vector3{0, v, 0};
+            particles.push_back(state, mass[k]);
+            momentum += mass[k] * v;
+        }
+        particles.setVelocity(0, Vector3{0, -momentum / Physics::Msol, 0});
+        return particles;
+    }
+    
+    // Wall time and energy error over a year of system, with and without
+    // its close pair regularised, at steps from 10 minutes to 6 hours.
+    static void binaryRows(Particles<long double> (*system)(), std::ostream& out) {
+        ThreadPool pool(1);
+        auto gravity = Gravity<long double>::named("direct", GravityConfig{});
+        Integrator::Forces<long double> forces{*gravity, pool};
+        
+        out << std::setw(12) << "scheme" << std::setw(12) << "regularised" << std::setw(10) << "step (s)"
+            << std::setw(14) << "wall time (s)" << std::setw(14) << "energy error" << std::endl;
+        
+        for(auto name : {"verlet", "yoshida4", "wh"}) {
+            for(bool regularise : {false, true}) {
+                for(auto step : BINARY_STEPS) {
+                    Integrator::Config config;
+                    config.regularise = regularise;
+                    auto particles = system();
+                    auto scheme = Integrator::Scheme<long double>::named(name, config);
+                    forces(particles);
+                    scheme->start(particles, forces);
+                    
+                    auto e0 = energy(particles);
+                    auto start = Clock::now();
+                    for(double t = 0; t < BINARY_SPAN;) {
+                        t += scheme->step(particles, forces, step);
+                    }
+                    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                    out << std::setw(12) << name << std::setw(12) << (regularise ? "yes" : "no")
+                        << std::setw(10) << step << std::setw(14) << seconds
+                        << std::setw(14) << (energy(particles) - e0) / e0 << std::endl;
+                }
+            }
+        }
+    }
+    
+    // A binary planet, at steps from a hundredth to a quarter of its orbit,
+    // and a planet on a tight orbit of its star.
+    static void binaries(std::ostream& out) {
+        out << "binary planet, " << BINARY_SEPARATION << " m apart, " << BINARY_SPAN / 86400 << " days, long double" << std::endl;
+        binaryRows(binary, out);
+        out << std::endl;
+        out << "planet " << HOT_DISTANCE << " AU from its star, with a jupiter at 5 AU, " << BINARY_SPAN / 86400 << " days, long double" << std::endl;
+        binaryRows(hotPlanet, out);
+    }
+    
+    // MARK: - Scattering
+    
+    static const double SCATTERING_SPAN = 20 * 365.25 * 86400;
+    static const double SCATTERING_STEPS[] = {21600, 86400, 345600};
+    
+    // A sun-like star with three jupiters on circular orbits at 1, 1.12 and
+    // 1.3 AU, too close to one another to stay apart: within a few years
+    // they pass within a thousandth of an AU.
+    static Particles<long double> scattering() {
+        const long double distance[] = {1, 1.12, 1.3};
+        const long double phase[] = {0, 2, 4};
+        
+        Particles<long double> particles;
+        Integrator::State<long double> state;
+        particles.push_back(state, Physics::Msol);
+        for(int i = 0; i < 3; ++i) {
+            long double r = distance[i] * Physics::AU;
+            long double v = std::sqrt(Physics::G * Physics::Msol / r);
+            state.position = Vector3{r * std::cos(phase[i]), r * std::sin(phase[i]), 0};
+            state.velocity = Vector3{-v * std::sin(phase[i]), v * std::cos(phase[i]), 0};
+            particles.push_back(state, 1.898e27);
+        }
+        return particles;
+    }
+    
+    // Wall time and largest energy error over twenty years of planet-planet
+    // scattering, for the Wisdom-Holman map, its hybrid with Bulirsch-Stoer
+    // during encounters, and IAS15.
+    static void scatter(std::ostream& out) {
+        ThreadPool pool(1);
+        auto gravity = Gravity<long double>::named("direct", GravityConfig{});
+        Integrator::Forces<long double> forces{*gravity, pool};
+        
+        out << "three jupiters, " << SCATTERING_SPAN / 86400 << " days, long double" << std::endl;
+        out << std::setw(12) << "scheme" << std::setw(10) << "step (s)"
+            << std::setw(14) << "wall time (s)" << std::setw(14) << "energy error" << std::endl;
+        
+        for(auto name : {"wh", "hybrid", "ias15"}) {
+            for(auto step : SCATTERING_STEPS) {
+                auto particles = scattering();
+                auto scheme = Integrator::Scheme<long double>::named(name, Integrator::Config{});
+                forces(particles);
+                scheme->start(particles, forces);
+                
+                auto e0 = energy(particles);
+                long double drift = 0;
+                double seconds = 0;
+                for(double t = 0; t < SCATTERING_SPAN;) {
+                    auto start = Clock::now();
+                    t += scheme->step(particles, forces, step);
+                    seconds += std::chrono::duration<double>(Clock::now() - start).count();
+                    drift = std::max(drift, std::abs((energy(particles) - e0) / e0));
+                }
+                out << std::setw(12) << name << std::setw(10) << step
+                    << std::setw(14) << seconds << std::setw(14) << drift << std::endl;
+            }
+        }
+    }
+    
+    // MARK: - Parareal
+    
+    static const char* const PARAREAL_SCHEME = "yoshida4";
+    static const double PARAREAL_STEP = 600;
+    static const unsigned PARAREAL_SLICES = 8;
+    static const int PARAREAL_WINDOWS = 32;
+    static const unsigned PARAREAL_THREADS[] = {1, 2, 4, 8};
+    
+    // Wall time of the same run with the fine scheme alone and with Parareal
+    // on a range of threads, the iterations Parareal took per step, and how
+    // far its bodies end up from where the fine scheme alone puts them.
+    static void parareal(const std::vector<std::string>& files, std::ostream& out) {
+        typedef Integrator::Parareal<long double> Parareal;
+        const double window = PARAREAL_STEP * PARAREAL_SLICES * Parareal::FINE;
+        
+        for(const auto& path : files) {
+            std::ifstream in{path};
+            if(!in.is_open()) {
+                out << path << ": cannot open file" << std::endl;
+                continue;
+            }
+            StarSystem<long double> system{in, Physics::J2000,
+                                           Gravity<long double>::named("direct", GravityConfig{}),
+                                           Integrator::Scheme<long double>::named(PARAREAL_SCHEME, Integrator::Config{}), 1};
+            auto gravity = Gravity<long double>::named("direct", GravityConfig{});
+            
+            out << path << ", " << PARAREAL_SCHEME << " at " << PARAREAL_STEP << "s, "
+                << PARAREAL_WINDOWS * window / 86400 << " days in " << PARAREAL_SLICES << " slices per "
+                << window / 86400 << " days" << std::endl;
+            out << std::setw(10) << "threads" << std::setw(14) << "wall time (s)"
+                << std::setw(12) << "iterations" << std::setw(18) << "position error" << std::endl;
+            
+            auto reference = system.particles();
+            {
+                ThreadPool pool(1);
+                Integrator::Forces<long double> forces{*gravity, pool};
+                auto scheme = Integrator::Scheme<long double>::named(PARAREAL_SCHEME, Integrator::Config{});
+                forces(reference);
+                scheme->start(reference, forces);
+                auto start = Clock::now();
+                for(unsigned i = 0; i < PARAREAL_WINDOWS * PARAREAL_SLICES * Parareal::FINE; ++i) {
+                    scheme->step(reference, forces, PARAREAL_STEP);
+                }
+                out << std::setw(10) << "serial"
+                    << std::setw(14) << std::chrono::duration<double>(Clock::now() - start).count()
+                    << std::setw(12) << "-" << std::setw(16) << 0 << " m" << std::endl;
+            }
+            
+            for(auto threads : PARAREAL_THREADS) {
+                ThreadPool pool(threads);
+                Integrator::Forces<long double> forces{*gravity, pool};
+                Integrator::Config config;
+                Parareal scheme{PARAREAL_SCHEME, config, PARAREAL_SLICES};
+                auto particles = system.particles();
+                forces(particles);
+                scheme.start(particles, forces);
+                
+                unsigned iterations = 0;
+                auto start = Clock::now();
+                for(int i = 0; i < PARAREAL_WINDOWS; ++i) {
+                    scheme.step(particles, forces, window);
+                    iterations += scheme.iterations();
+                }
+                double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                
+                long double error = 0;
+                for(std::size_t i = 0; i < particles.size(); ++i) {
+                    error = std::max(error, (particles.position(i) - reference.position(i)).magnitude());
+                }
+                out << std::setw(10) << threads << std::setw(14) << seconds
+                    << std::setw(12) << double(iterations) / PARAREAL_WINDOWS
+                    << std::setw(16) << error << " m" << std::endl;
+            }
+        }
+    }
+    
+    // MARK: - Kepler's equation
+    
+    static const std::size_t KEPLER_COUNT = 100000;
+    static const double KEPLER_ECCENTRICITIES[] = {0.1, 0.9, 0.999, 0.999999, 1.000001, 1.001, 1.5, 10};
+    
+    // Time per anomaly of the batch Kepler solvers, and their largest
+    // residual in units of the rounding of M, over mean anomalies spread
+    // across many orders of magnitude.
+    static void kepler(std::ostream& out) {
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> exponent(-8, 3);
+        std::vector<double> M(KEPLER_COUNT), e(KEPLER_COUNT), E(KEPLER_COUNT);
+        for(auto& m : M) {
+            m = (rng() & 1 ? 1 : -1) * std::pow(10.0, exponent(rng));
+        }
+        
+        out << KEPLER_COUNT << " mean anomalies from 1e-8 to 1e3, double" << std::endl;
+        out << std::setw(14) << "eccentricity" << std::setw(12) << "ns/solve" << std::setw(12) << "residual" << std::endl;
+        for(auto eccentricity : KEPLER_ECCENTRICITIES) {
+            std::fill(e.begin(), e.end(), eccentricity);
+            bool elliptic = eccentricity < 1;
+            double seconds = time([&] {
+                if(elliptic) {
+                    Orbit::eccentricAnomalies(M.data(), e.data(), E.data(), KEPLER_COUNT);
+                } else {
+                    Orbit::hyperbolicAnomalies(M.data(), e.data(), E.data(), KEPLER_COUNT);
+                }
+            });
+            
+            long double residual = 0;
+            for(std::size_t i = 0; i < KEPLER_COUNT; ++i) {
+                long double x = E[i];
+                long double f = elliptic ? x - e[i] * std::sin(x) - M[i] : e[i] * std::sinh(x) - x - M[i];
+                long double scale = std::max<long double>(std::abs(M[i]), elliptic ? 1.0L : e[i] * std::cosh(x));
+                residual = std::max(residual, std::abs(f) / scale);
+            }
+            out << std::setprecision(7) << std::setw(14) << eccentricity << std::setprecision(4)
+                << std::setw(12) << seconds / KEPLER_COUNT * 1e9
+                << std::setw(12) << residual / Scalar::epsilon<double>() << std::endl;
+        }
+    }
+    
+    // MARK: - Orbital elements
+    
+    static const std::size_t ELEMENTS_COUNT = 200000;
+    
+    // Time per orbit of a conversion from elements to state vectors, one
+    // Orbit at a time as systems used to be loaded, and in batches in every
+    // precision on one thread and on all of them.
+    template <typename T>
+    static void elementRows(const std::vector<std::array<double, 6>>& orbits, std::ostream& out) {
+        Elements<T> elements;
+        for(const auto& o : orbits) {
+            elements.push_back(o[0], o[1], radians(o[2]), radians(o[3]), radians(o[4]), radians(o[5]), Physics::J2000);
+        }
+        std::vector<typename Elements<T>::W> GM(orbits.size(), Physics::G * Physics::Msol);
+        Particles<T> particles;
+        for(std::size_t i = 0; i < orbits.size(); ++i) {
+            particles.push_back(Integrator::State<T>{vec3<T>{}, vec3<T>{}, vec3<T>{}}, 0);
+        }
+        
+        for(unsigned threads : {1u, 0u}) {
+            ThreadPool pool(threads);
+            double seconds = time([&] { elements.stateVectors(GM, Physics::J2000 + 100, particles, 0, pool); });
+            out << std::setw(14) << Scalar::name<T>() << std::setw(10) << pool.size()
+                << std::setw(12) << seconds / orbits.size() * 1e9 << std::endl;
+        }
+    }
+    
+    static void elements(std::ostream& out) {
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> unit(0, 1);
+        std::vector<std::array<double, 6>> orbits(ELEMENTS_COUNT);
+        for(auto& o : orbits) {
+            o = {(0.3 + 50 * unit(rng)) * double(Physics::AU), 0.95 * unit(rng), 180 * unit(rng),
+                 360 * unit(rng), 360 * unit(rng), 360 * unit(rng)};
+        }
+        
+        out << ELEMENTS_COUNT << " elliptic orbits" << std::endl;
+        out << std::setw(14) << "conversion" << std::setw(10) << "threads" << std::setw(12) << "ns/orbit" << std::endl;
+        
+        std::vector<std::pair<Vector3, Vector3>> states(ELEMENTS_COUNT);
+        double seconds = time([&] {
+            for(std::size_t i = 0; i < ELEMENTS_COUNT; ++i) {
+                const auto& o = orbits[i];
+                auto orbit = Orbit::Builder().semiMajorAxis(o[0]).eccentricity(o[1]).inclination(o[2])
+                    .argOfPeriapsis(o[3]).rightAscension(o[4]).meanAnomaly(o[5]).build();
+                states[i] = orbit.stateVectors(Physics::G * Physics::Msol, Physics::J2000 + 100);
+            }
+        });
+        out << std::setw(14) << "orbit" << std::setw(10) << 1 << std::setw(12) << seconds / ELEMENTS_COUNT * 1e9 << std::endl;
+        elementRows<float>(orbits, out);
+        elementRows<double>(orbits, out);
+        elementRows<long double>(orbits, out);
+    }
+    
+    // MARK: - Osculating elements
+    
+    // Time per body of the conversion from state vectors to osculating
+    // elements, in every precision on one thread and on all of them, and the
+    // largest error in units of the rounding of the position after a round
+    // trip from elements to states, to elements and to states again.
+    template <typename T>
+    static void osculatingRows(const std::vector<std::array<double, 6>>& orbits, std::ostream& out) {
+        typedef typename Elements<T>::W W;
+        Elements<T> elements;
+        for(const auto& o : orbits) {
+            elements.push_back(o[0], o[1], radians(o[2]), radians(o[3]), radians(o[4]), radians(o[5]), Physics::J2000);
+        }
+        Particles<T> particles, again;
+        particles.push_back(Integrator::State<T>{vec3<T>{}, vec3<T>{}, vec3<T>{}}, Physics::Msol);
+        for(std::size_t i = 0; i < orbits.size(); ++i) {
+            particles.push_back(Integrator::State<T>{vec3<T>{}, vec3<T>{}, vec3<T>{}}, 0);
+        }
+        std::vector<W> GM(orbits.size(), Physics::G * Physics::Msol);
+        ThreadPool one(1);
+        elements.stateVectors(GM, Physics::J2000 + 100, particles, 1, one);
+        
+        Elements<T> osculating;
+        osculating.osculating(particles, 1, Elements<T>::Centre::STAR, Physics::J2000 + 100, one);
+        again = particles;
+        osculating.stateVectors(GM, Physics::J2000 + 100, again, 1, one);
+        long double error = 0;
+        for(std::size_t i = 1; i < particles.size(); ++i) {
+            vec3<long double> x = particles.position(i), y = again.position(i);
+            error = std::max(error, (x - y).magnitude() / x.magnitude());
+        }
+        
+        for(unsigned threads : {1u, 0u}) {
+            ThreadPool pool(threads);
+            double seconds = time([&] {
+                osculating.osculating(particles, 1, Elements<T>::Centre::STAR, Physics::J2000 + 100, pool);
+            });
+            out << std::setw(14) << Scalar::name<T>() << std::setw(10) << pool.size()
+                << std::setw(12) << seconds / orbits.size() * 1e9
+                << std::setw(12) << double(error / Scalar::epsilon<T>()) << std::endl;
+        }
+    }
+    
+    static void osculating(std::ostream& out) {
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> unit(0, 1);
+        std::vector<std::array<double, 6>> orbits(ELEMENTS_COUNT);
+        for(std::size_t k = 0; k < ELEMENTS_COUNT; ++k) {
+            // One orbit in ten is a hyperbola, with its mean anomaly within
+            // a few radians of periapsis.
+            bool hyperbolic = k % 10 == 0;
+            double a = (0.3 + 50 * unit(rng)) * double(Physics::AU);
+            orbits[k] = {hyperbolic ? -a : a, hyperbolic ? 1 + 4 * unit(rng) : 0.95 * unit(rng), 180 * unit(rng),
+                         360 * unit(rng), 360 * unit(rng), hyperbolic ? 360 * unit(rng) - 180 : 360 * unit(rng)};
+        }
+        
+        out << ELEMENTS_COUNT << " orbits, one in ten hyperbolic" << std::endl;
+        out << std::setw(14) << "precision" << std::setw(10) << "threads" << std::setw(12) << "ns/body" << std::setw(12) << "round trip" << std::endl;
+        osculatingRows<float>(orbits, out);
+        osculatingRows<double>(orbits, out);
+        osculatingRows<long double>(orbits, out);
+    }
+    
+    // MARK: - Universal variables
+    
+    static const std::size_t PROPAGATE_COUNT = 10000;
+    static const double PROPAGATE_SPEEDS[] = {0.3, 0.9, 1.3, 1.41421356, 1.5, 3};
+    static const double PROPAGATE_DAYS[] = {1, 365, 36525};
+    
+    // Time per call of the universal-variable propagator in double, and its
+    // largest error in units of the rounding of the position, against the
+    // same propagation in long double, for bodies 1 AU from the Sun at the
+    // given fractions of the circular speed in random directions.
+    static void propagate(std::ostream& out) {
+        std::mt19937_64 rng(42);
+        std::normal_distribution<double> normal;
+        const double GM = Physics::G * Physics::Msol;
+        const double AU = Physics::AU;
+        
+        out << PROPAGATE_COUNT << " bodies 1 AU from the Sun, double" << std::endl;
+        out << std::setw(8) << "v/vc" << std::setw(10) << "days" << std::setw(12) << "ns/call" << std::setw(12) << "error" << std::endl;
+        for(auto speed : PROPAGATE_SPEEDS) {
+            std::vector<vec3<double>> positions(PROPAGATE_COUNT), velocities(PROPAGATE_COUNT);
+            for(std::size_t i = 0; i < PROPAGATE_COUNT; ++i) {
+                vec3<double> x{normal(rng), normal(rng), normal(rng)};
+                vec3<double> v{normal(rng), normal(rng), normal(rng)};
+                positions[i] = (AU / x.magnitude()) * x;
+                velocities[i] = (speed * std::sqrt(GM / AU) / v.magnitude()) * v;
+            }
+            
+            for(auto days : PROPAGATE_DAYS) {
+                double dt = days * 86400;
+                auto x = positions, v = velocities;
+                double seconds = time([&] {
+                    for(std::size_t i = 0; i < PROPAGATE_COUNT; ++i) {
+                        Orbit::propagate(x[i], v[i], GM, dt);
+                    }
+                });
+                
+                long double error = 0;
+                for(std::size_t i = 0; i < PROPAGATE_COUNT; ++i) {
+                    vec3<double> position = positions[i], velocity = velocities[i];
+                    vec3<long double> reference = positions[i], motion = velocities[i];
+                    Orbit::propagate(position, velocity, GM, dt);
+                    Orbit::propagate(reference, motion, (long double)GM, (long double)dt);
+                    error = std::max(error, (vec3<long double>(position) - reference).magnitude() / reference.magnitude());
+                }
+                out << std::setw(8) << speed << std::setw(10) << days
+                    << std::setw(12) << seconds / PROPAGATE_COUNT * 1e9
+                    << std::setw(12) << error / Scalar::epsilon<double>() << std::endl;
+            }
+        }
+    }
+    
+    bool run(const std::string& name, const std::vector<std::string>& files, std::ostream& out) {
+        out << std::setprecision(4);
+        if(name == "simd") {
+            simd(out);
+            return true;
+        }
+        if(name == "precision") {
+            precision(files, out);
+            return true;
+        }
+        if(name == "schemes") {
+            schemes(files, out);
+            return true;
+        }
+        if(name == "accuracy") {
+            accuracy(files, out);
+            return true;
+        }
+        if(name == "disk") {
+            debris(out);
+            return true;
+        }
+        if(name == "massless") {
+            massless(out);
+            return true;
+        }
+        if(name == "binary") {
+            binaries(out);
+            return true;
+        }
+        if(name == "scattering") {
+            scatter(out);
+            return true;
+        }
+        if(name == "parareal") {
+            parareal(files, out);
+            return true;
+        }
+        if(name == "kepler") {
+            kepler(out);
+            return true;
+        }
+        if(name == "elements") {
+            elements(out);
+            return true;
+        }
+        if(name == "propagate") {
+            propagate(out);
+            return true;
+        }
+        if(name == "osculating") {
+            osculating(out);
+            return true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,18 @@
+//
+// exo
+// Benchmark.hpp - Headless performance measurements.
+//
+// Benchmarks run without opening a window and print their results as plain
+// text tables, so they can be compared across machines and builds.
+//
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Benchmark {
+    
+    // Runs the benchmark called name on the given system files, if it needs
+    // any. Returns false if there is no such benchmark.
+    bool run(const std::string& name, const std::vector<std::string>& files, std::ostream& out);
+}
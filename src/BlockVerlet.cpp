@@ -0,0 +1,95 @@
+//
+// exo
+// BlockVerlet.cpp - Kick-drift-kick Verlet with per-body block timesteps.
+//
+#include <algorithm>
+#include <cmath>
+#include "BlockVerlet.hpp"
+
+namespace Integrator {
+    
+    // Fraction of |a| / |da/dt| a body may step over.
+    static const double ETA = 0.0025;
+    
+    template <typename T>
+    void BlockVerlet<T>::start(Particles<T>& particles, const Forces<T>& forces) {
+        levels_.assign(particles.size(), 0);
+        ends_.assign(particles.size(), 0);
+        previous_.assign(particles.size(), vec3<T>{0, 0, 0});
+        jerk_.assign(particles.size(), 0);
+        resetCarry(carry_, compensated_ ? particles.size() : 0);
+    }
+    
+    template <typename T>
+    int BlockVerlet<T>::level(const Particles<T>& particles, std::size_t i, T dt, uint32_t now) const {
+        typedef Scalar::Wide<T> W;
+        W a = vec3<W>(particles.acceleration(i)).magnitude();
+        W rate = jerk_[i] > 0 ? W(jerk_[i]) : a * a / vec3<W>(particles.velocity(i)).magnitude();
+        
+        W limit = a > 0 ? W(ETA) * a / rate : W(0);
+        return Integrator::level(limit, W(dt), now);
+    }
+    
+    template <typename T>
+    void BlockVerlet<T>::kick(Particles<T>& particles, std::size_t i, T dt) {
+        auto state = particles.state(i);
+        if(compensated_) {
+            auto velocityCarry = carry_.velocity(i);
+            Integrator::kick(state, velocityCarry, dt);
+            carry_.setVelocity(i, velocityCarry);
+        } else {
+            Integrator::kick(state, dt);
+        }
+        particles.setVelocity(i, state.velocity);
+    }
+    
+    template <typename T>
+    T BlockVerlet<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        auto* carry = compensated_ ? &carry_ : nullptr;
+        const auto count = particles.size();
+        auto span = [&](std::size_t i) { return T(dt / (1u << levels_[i])); };
+        
+        // Every body starts its step together, with accelerations up to date.
+        for(std::size_t i = 0; i < count; ++i) {
+            levels_[i] = level(particles, i, dt, 0);
+            ends_[i] = TICKS >> levels_[i];
+            kick(particles, i, T(0.5 * span(i)));
+        }
+        
+        uint32_t now = 0;
+        while(now < TICKS) {
+            uint32_t next = *std::min_element(ends_.begin(), ends_.end());
+            drift(particles, carry, T(dt * (next - now) / TICKS), forces.pool);
+            now = next;
+            
+            active_.clear();
+            for(std::size_t i = 0; i < count; ++i) {
+                if(ends_[i] == now) { active_.push_back(i); }
+            }
+            for(auto i : active_) {
+                previous_[i] = particles.acceleration(i);
+            }
+            // A full pass shares the work of each pair between its bodies.
+            if(active_.size() == count) {
+                forces(particles);
+            } else {
+                forces(particles, active_);
+            }
+            
+            for(auto i : active_) {
+                jerk_[i] = (particles.acceleration(i) - previous_[i]).magnitude() / span(i);
+                kick(particles, i, T(0.5 * span(i)));
+                if(now == TICKS) { continue; }
+                
+                levels_[i] = level(particles, i, dt, now);
+                ends_[i] = now + (TICKS >> levels_[i]);
+                kick(particles, i, T(0.5 * span(i)));
+            }
+        }
+        return dt;
+    }
+    
+#define INSTANTIATE(T) template class BlockVerlet<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
@@ -0,0 +1,54 @@
+//
+// exo
+// BlockVerlet.hpp - Kick-drift-kick Verlet with per-body block timesteps.
+//
+// Every body steps at dt / 2^level, where its level is picked from how fast
+// its acceleration turns: a fraction of |a| / |da/dt|, about an orbital
+// period over 2 pi for a body on a circular orbit. The rate of change is
+// measured over the body's last step; until it has taken one, |v| / |a|
+// stands in for it. Every step length divides dt, so all
+// bodies line up again at the end of a step. In between, all bodies drift
+// together from one step boundary to the next, and only the bodies whose
+// step ends there get new accelerations and their kicks. Outer bodies can
+// skip most force passes of the inner ones.
+//
+// dt is the longest step any body takes. A body moves to a longer step only
+// at a time that step's grid lines up with, and to a shorter one at once.
+//
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Scheme.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class BlockVerlet : public Scheme<T> {
+    public:
+        
+        // With compensated set, rounding errors of the position and velocity
+        // updates are carried over from step to step.
+        explicit BlockVerlet(bool compensated) : compensated_(compensated) {}
+        
+        void start(Particles<T>& particles, const Forces<T>& forces) override;
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+    private:
+        
+        // Level body i should step at out of dt, no coarser than the grid at
+        // tick now allows.
+        int level(const Particles<T>& particles, std::size_t i, T dt, uint32_t now) const;
+        
+        // Kicks body i alone for dt.
+        void kick(Particles<T>& particles, std::size_t i, T dt);
+        
+        bool                    compensated_;
+        Particles<T>            carry_;
+        std::vector<int>        levels_;
+        std::vector<uint32_t>   ends_;      // tick each body's step ends at
+        std::vector<vec3<T>>    previous_;  // accelerations before the last force pass
+        std::vector<T>          jerk_;      // |da/dt| over the last step, 0 until known
+        std::vector<uint32_t>   active_;
+    };
+}
@@ -0,0 +1,178 @@
+//
+// exo
+// BulirschStoer.cpp - Gragg-Bulirsch-Stoer extrapolation scheme.
+//
+#include <algorithm>
+#include <cmath>
+#include "BulirschStoer.hpp"
+
+namespace Integrator {
+    
+    // Most rows in the extrapolation table; row j uses 2 (j + 1) substeps.
+    static const int MAX_ROWS = 10;
+    
+    // Relative error allowed on each step, and at least this many times the
+    // machine epsilon: the state is rounded to T after every step, so a
+    // narrower type could never meet a tighter one.
+    static const double TOLERANCE = 1e-14;
+    static const double ROUNDING = 8;
+    
+    // Bounds on how much a step may shrink or grow at once, and the safety
+    // factors of ODEX's step size controller.
+    static const double MIN_FACTOR = 0.02;
+    static const double MAX_FACTOR = 4;
+    static const double SAFETY = 0.94;
+    static const double SAFETY_ERROR = 0.65;
+    
+    static int substeps(int row) { return 2 * (row + 1); }
+    
+    template <typename T>
+    void BulirschStoer<T>::start(Particles<T>& particles, const Forces<T>& forces) {
+        const auto n = 6 * particles.size();
+        table_.assign(MAX_ROWS, {});
+        for(int j = 0; j < MAX_ROWS; ++j) {
+            table_[j].assign(j + 1, std::vector<W>(n, 0));
+        }
+        previous_.assign(n, 0);
+        current_.assign(n, 0);
+        scale_.assign(n, 0);
+        stage_ = particles;
+        rows_ = 5;
+        next_ = 0;
+    }
+    
+    template <typename T>
+    void BulirschStoer<T>::midpoint(const Particles<T>& particles, const Forces<T>& forces, W H, int n, std::vector<W>& result) {
+        const auto count = particles.size();
+        const W h = H / n;
+        
+        // z1 = z0 + h f(z0), with the accelerations the particles already have.
+        for(std::size_t i = 0; i < count; ++i) {
+            vec3<W> x = particles.position(i), v = particles.velocity(i), a = particles.acceleration(i);
+            for(int c = 0; c < 3; ++c) {
+                previous_[6 * i + c] = x[c];
+                previous_[6 * i + 3 + c] = v[c];
+                current_[6 * i + c] = x[c] + h * v[c];
+                current_[6 * i + 3 + c] = v[c] + h * a[c];
+            }
+        }
+        
+        // z(m+1) = z(m-1) + 2h f(z(m))
+        for(int m = 1; m < n; ++m) {
+            for(std::size_t i = 0; i < count; ++i) {
+                stage_.setPosition(i, vec3<W>{current_[6 * i], current_[6 * i + 1], current_[6 * i + 2]});
+            }
+            forces(stage_);
+            for(std::size_t i = 0; i < count; ++i) {
+                vec3<W> a = stage_.acceleration(i);
+                for(int c = 0; c < 3; ++c) {
+                    W x = previous_[6 * i + c] + 2 * h * current_[6 * i + 3 + c];
+                    W v = previous_[6 * i + 3 + c] + 2 * h * a[c];
+                    previous_[6 * i + c] = current_[6 * i + c];
+                    previous_[6 * i + 3 + c] = current_[6 * i + 3 + c];
+                    current_[6 * i + c] = x;
+                    current_[6 * i + 3 + c] = v;
+                }
+            }
+        }
+        result = current_;
+    }
+    
+    template <typename T>
+    T BulirschStoer<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        const auto count = particles.size();
+        const auto n = 6 * count;
+        const W tolerance = std::max(W(TOLERANCE), W(ROUNDING * Scalar::epsilon<T>()));
+        
+        // Step lengths are worked out on |H|, and H goes in the direction of dt.
+        const W sign = dt < 0 ? -1 : 1;
+        W H = sign * (next_ > 0 ? std::min<W>(next_, std::abs(W(dt))) : std::abs(W(dt)));
+        
+        W work[MAX_ROWS];
+        W optimal[MAX_ROWS];
+        work[0] = substeps(0);
+        for(int j = 1; j < MAX_ROWS; ++j) {
+            work[j] = work[j - 1] + substeps(j);
+        }
+        
+        int accepted = -1;
+        while(accepted < 0) {
+            // Errors are measured against the size of each body's position
+            // and velocity, and how far they move over the step.
+            for(std::size_t i = 0; i < count; ++i) {
+                W x = vec3<W>(particles.position(i)).magnitude();
+                W v = vec3<W>(particles.velocity(i)).magnitude();
+                W a = vec3<W>(particles.acceleration(i)).magnitude();
+                for(int c = 0; c < 3; ++c) {
+                    scale_[6 * i + c] = tolerance * (x + std::abs(H) * v);
+                    scale_[6 * i + 3 + c] = tolerance * (v + std::abs(H) * a);
+                }
+            }
+            
+            const int last = std::min(rows_ + 1, MAX_ROWS - 1);
+            int row = 0;
+            for(; row <= last; ++row) {
+                auto& t = table_[row];
+                midpoint(particles, forces, H, substeps(row), t[0]);
+                if(row == 0) { continue; }
+                
+                // Aitken-Neville extrapolation in (H / n)^2.
+                for(int l = 1; l <= row; ++l) {
+                    W ratio = W(substeps(row)) / substeps(row - l);
+                    W denominator = ratio * ratio - 1;
+                    const auto& up = table_[row - 1][l - 1];
+                    for(std::size_t k = 0; k < n; ++k) {
+                        t[l][k] = t[l - 1][k] + (t[l - 1][k] - up[k]) / denominator;
+                    }
+                }
+                
+                W error = 0;
+                for(std::size_t k = 0; k < n; ++k) {
+                    if(scale_[k] > 0) {
+                        error = std::max(error, std::abs(t[row][k] - t[row - 1][k]) / scale_[k]);
+                    }
+                }
+                
+                W factor = error > 0 ? W(SAFETY) * std::pow(W(SAFETY_ERROR) / error, W(1) / (2 * row + 1)) : W(MAX_FACTOR);
+                factor = std::min(W(MAX_FACTOR), std::max(W(MIN_FACTOR), factor));
+                optimal[row] = std::abs(H) * factor;
+                
+                if(row >= rows_ - 1 && error <= 1) {
+                    accepted = row;
+                    break;
+                }
+            }
+            
+            if(accepted < 0) {
+                H = sign * optimal[std::min(row, last)];
+                rows_ = std::max(2, rows_ - 1);
+            }
+        }
+        
+        const auto& y = table_[accepted][accepted];
+        for(std::size_t i = 0; i < count; ++i) {
+            particles.setPosition(i, vec3<W>{y[6 * i], y[6 * i + 1], y[6 * i + 2]});
+            particles.setVelocity(i, vec3<W>{y[6 * i + 3], y[6 * i + 4], y[6 * i + 5]});
+        }
+        forces(particles);
+        
+        // The next step uses the number of rows that does the least work
+        // per unit of time: one fewer, the same, or one more.
+        int rows = accepted;
+        if(accepted >= 2 && work[accepted - 1] / optimal[accepted - 1] < 0.8 * work[accepted] / optimal[accepted]) {
+            rows = accepted - 1;
+            next_ = optimal[rows];
+        } else if(accepted + 1 < MAX_ROWS - 1 && (accepted < 2 || work[accepted] / optimal[accepted] < 0.9 * work[accepted - 1] / optimal[accepted - 1])) {
+            rows = accepted + 1;
+            next_ = optimal[accepted] * work[rows] / work[accepted];
+        } else {
+            next_ = optimal[accepted];
+        }
+        rows_ = std::max(2, rows);
+        return T(H);
+    }
+
+#define INSTANTIATE(T) template class BulirschStoer<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
@@ -0,0 +1,49 @@
+//
+// exo
+// BulirschStoer.hpp - Gragg-Bulirsch-Stoer extrapolation scheme.
+//
+// A step of length H is taken several times with the modified midpoint
+// rule, with n = 2, 4, 6, ... substeps. The midpoint error only has even
+// powers of H / n, so Richardson extrapolation of the results to zero
+// substep length gains two orders with every row. Rows are added until the
+// last two estimates agree to the tolerance; the step and the number of
+// rows for the next step are picked to do the least work per unit of time,
+// as in Hairer and Wanner's ODEX. Short steps at high order are what close
+// encounters need.
+//
+// dt is the longest step. The scheme needs no starting values, so steps can
+// change length freely.
+//
+#pragma once
+#include <vector>
+#include "Scheme.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class BulirschStoer : public Scheme<T> {
+    public:
+        
+        typedef Scalar::Wide<T> W;
+        
+        void start(Particles<T>& particles, const Forces<T>& forces) override;
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+    private:
+        
+        // Runs the modified midpoint rule over H with n substeps, from the
+        // state of the particles, into result.
+        void midpoint(const Particles<T>& particles, const Forces<T>& forces, W H, int n, std::vector<W>& result);
+        
+        // State vectors, six to a body: positions then velocities.
+        std::vector<std::vector<std::vector<W>>>    table_;     // extrapolation rows
+        std::vector<W>                              previous_;
+        std::vector<W>                              current_;
+        std::vector<W>                              scale_;     // tolerance of each component
+        Particles<T>                                stage_;
+        
+        int     rows_ = 5;      // rows the next step is expected to need
+        W       next_ = 0;      // length of the next step, 0 until known
+    };
+}
@@ -0,0 +1,86 @@
+//
+// exo
+// Composition.cpp - Higher-order symplectic compositions of kicks and drifts.
+//
+#include <cmath>
+#include "Composition.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    Composition<T>::Composition(const std::vector<double>& kicks, const std::vector<double>& drifts, bool compensated)
+    : kicks_(kicks)
+    , drifts_(drifts)
+    , compensated_(compensated) {
+    }
+    
+    template <typename T>
+    Composition<T>* Composition<T>::verlet(const std::vector<double>& weights, bool compensated) {
+        std::vector<double> kicks(weights.size() + 1, 0);
+        for(std::size_t i = 0; i < weights.size(); ++i) {
+            kicks[i] += 0.5 * weights[i];
+            kicks[i + 1] += 0.5 * weights[i];
+        }
+        return new Composition(kicks, weights, compensated);
+    }
+    
+    template <typename T>
+    Composition<T>* Composition<T>::yoshida(int order, bool compensated) {
+        // Yoshida (1990), Phys. Lett. A 150, 262: the triple jump for order 4,
+        // and solutions A and D of table 1 for orders 6 and 8. The outermost
+        // weights are listed first, and the middle one makes the sum one.
+        std::vector<double> half;
+        if(order == 4) {
+            half = {1 / (2 - std::cbrt(2.0))};
+        } else if(order == 6) {
+            half = {0.784513610477560e0, 0.235573213359357e0, -0.117767998417887e1};
+        } else if(order == 8) {
+            half = {0.914844246229740e0, 0.253693336566229e0, -0.144485223686048e1,
+                    -0.158240635368243e0, 0.193813913762276e1, -0.196061023297549e1,
+                    0.102799849391985e0};
+        } else {
+            return nullptr;
+        }
+        
+        double middle = 1;
+        for(auto w : half) { middle -= 2 * w; }
+        
+        std::vector<double> weights = half;
+        weights.push_back(middle);
+        weights.insert(weights.end(), half.rbegin(), half.rend());
+        return verlet(weights, compensated);
+    }
+    
+    template <typename T>
+    Composition<T>* Composition<T>::forestRuth(bool compensated) {
+        // Omelyan, Mryglod & Folk (2002), Comput. Phys. Commun. 146, 188,
+        // equation (44): the velocity form, whose outer stages are kicks.
+        const double xi = 0.1644986515575760;
+        const double lambda = -0.2094333910398989e-1;
+        const double chi = 0.1235692651138917e1;
+        return new Composition({xi, chi, 1 - 2 * (chi + xi), chi, xi},
+                               {0.5 - lambda, lambda, lambda, 0.5 - lambda},
+                               compensated);
+    }
+    
+    template <typename T>
+    void Composition<T>::start(Particles<T>& particles, const Forces<T>& forces) {
+        resetCarry(carry_, compensated_ ? particles.size() : 0);
+    }
+    
+    template <typename T>
+    T Composition<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        auto* carry = compensated_ ? &carry_ : nullptr;
+        for(std::size_t i = 0; i < drifts_.size(); ++i) {
+            kick(particles, carry, T(kicks_[i] * dt), forces.pool);
+            drift(particles, carry, T(drifts_[i] * dt), forces.pool);
+            forces(particles);
+        }
+        kick(particles, carry, T(kicks_.back() * dt), forces.pool);
+        return dt;
+    }
+
+#define INSTANTIATE(T) template class Composition<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
@@ -0,0 +1,49 @@
+//
+// exo
+// Composition.hpp - Higher-order symplectic compositions of kicks and drifts.
+//
+// A composition alternates whole-system kicks and drifts with fixed weights,
+// starting and ending with a kick. Well-chosen weights cancel the error terms
+// of Verlet up to a higher order: each drift costs a force pass, but over a
+// long run the step can grow by far more than the extra passes cost.
+//
+#pragma once
+#include <vector>
+#include "Scheme.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class Composition : public Scheme<T> {
+    public:
+        
+        // kicks has one more weight than drifts, and both sum to one. With
+        // compensated set, rounding errors of the updates are carried over
+        // from step to step.
+        Composition(const std::vector<double>& kicks, const std::vector<double>& drifts, bool compensated);
+        
+        // Chains velocity Verlet steps of the given weights, merging the
+        // half kicks where two steps meet.
+        static Composition* verlet(const std::vector<double>& weights, bool compensated);
+        
+        // Yoshida's compositions of order 4, 6 or 8, of 3, 7 and 15 Verlet
+        // steps. Returns nullptr for any other order.
+        static Composition* yoshida(int order, bool compensated);
+        
+        // Omelyan, Mryglod and Folk's optimised Forest-Ruth-like scheme of
+        // order 4, in its velocity form, which starts and ends with a kick.
+        // It takes four force passes, one more than Yoshida's, for an energy
+        // error about thirty times smaller on the schemes benchmark.
+        static Composition* forestRuth(bool compensated);
+        
+        void start(Particles<T>& particles, const Forces<T>& forces) override;
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+    private:
+        std::vector<double> kicks_;
+        std::vector<double> drifts_;
+        bool                compensated_;
+        Particles<T>        carry_;
+    };
+}
@@ -0,0 +1,117 @@
+//
+// exo
+// ElementStream.cpp - Osculating elements written out behind the integration.
+//
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include "ElementStream.hpp"
+#include "Math/Utils.hpp"
+#include "Physics.hpp"
+#include "ThreadPool.hpp"
+
+// Copies that may wait for the writer at once.
+static const std::size_t QUEUE = 4;
+
+template <typename T>
+ElementStream<T>::ElementStream(std::ostream& out, const std::vector<std::string>& names,
+                                unsigned decimation, Centre centre, bool lossy)
+: out_(out)
+, names_(names)
+, decimation_(std::max(decimation, 1u))
+, countdown_(0)
+, centre_(centre)
+, lossy_(lossy)
+, dropped_(0)
+, stop_(false) {
+    out_ << "# jd, name, a (AU), e, i, node, periapsis, mean anomaly (degrees), from the "
+         << (centre_ == Centre::STAR ? "star" : "barycentre") << std::endl;
+    writer_ = std::thread(&ElementStream::write, this);
+}
+
+template <typename T>
+ElementStream<T>::~ElementStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+    if(dropped_ > 0) {
+        out_ << "# " << dropped_ << " records dropped, the writer having fallen behind" << std::endl;
+    }
+}
+
+template <typename T>
+std::size_t ElementStream<T>::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+template <typename T>
+void ElementStream<T>::step(const Particles<T>& particles, long double julianDate) {
+    if(countdown_-- > 0) { return; }
+    countdown_ = decimation_ - 1;
+    
+    // Assigning to a recycled copy reuses its arrays.
+    Snapshot snapshot{julianDate, Particles<T>()};
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(lossy_ && queue_.size() >= QUEUE) {
+            ++dropped_;
+            return;
+        }
+        room_.wait(lock, [this] { return queue_.size() < QUEUE; });
+        if(!spare_.empty()) {
+            snapshot.particles = std::move(spare_.back());
+            spare_.pop_back();
+        }
+    }
+    snapshot.particles = particles;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(snapshot));
+    }
+    wake_.notify_one();
+}
+
+template <typename T>
+void ElementStream<T>::write() {
+    const std::size_t first = centre_ == Centre::STAR ? 1 : 0;
+    ThreadPool pool(1);
+    Elements<T> elements;
+    
+    for(;;) {
+        Snapshot snapshot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if(queue_.empty()) { break; }
+            snapshot = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        room_.notify_one();
+        
+        elements.osculating(snapshot.particles, first, centre_, snapshot.date, pool);
+        for(std::size_t k = 0; k < elements.size(); ++k) {
+            auto i = first + k;
+            out_ << std::fixed << std::setprecision(8) << snapshot.date << ", "
+                 << (i < names_.size() ? names_[i] : std::to_string(i)) << ", "
+                 << std::defaultfloat << std::setprecision(std::numeric_limits<double>::max_digits10)
+                 << double(elements.semiMajorAxis(k) / Physics::AU) << ", "
+                 << double(elements.eccentricity(k)) << ", "
+                 << degrees(double(elements.inclination(k))) << ", "
+                 << degrees(double(elements.rightAscension(k))) << ", "
+                 << degrees(double(elements.argOfPeriapsis(k))) << ", "
+                 << degrees(double(elements.meanAnomaly(k))) << "\n";
+        }
+        out_.flush();
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        spare_.push_back(std::move(snapshot.particles));
+    }
+}
+
+#define INSTANTIATE(T) template class ElementStream<T>;
+EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
@@ -0,0 +1,79 @@
+//
+// exo
+// ElementStream.hpp - Osculating elements written out behind the integration.
+//
+// Every decimation-th step the stream copies the particles and returns. A
+// writer thread of its own converts the copies to osculating elements and
+// writes them out, so steps never wait on the conversion, the formatting or
+// the disk. Copies are recycled once written. At most a few wait in the
+// queue, so memory stays bounded: when the writer falls that far behind,
+// the step waits for room, and every decimation-th step is written. A lossy
+// stream drops the record instead, so steps are never held back, and writes
+// the count of records dropped at the end of the stream.
+//
+// Each line holds a Julian date, a body's name, its semi-major axis in AU,
+// eccentricity, inclination, longitude of the ascending node, argument of
+// periapsis and mean anomaly in degrees: the units of system files.
+//
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Elements.hpp"
+#include "Particles.hpp"
+
+template <typename T>
+class ElementStream {
+public:
+    
+    typedef typename Elements<T>::Centre Centre;
+    
+    // Writes the elements of the bodies with the given names, all but the
+    // first when they are measured from it, to out every decimation steps.
+    // With lossy set, records that find the queue full are dropped.
+    ElementStream(std::ostream& out, const std::vector<std::string>& names,
+                  unsigned decimation, Centre centre, bool lossy);
+    
+    // Writes out what is still queued.
+    ~ElementStream();
+    
+    ElementStream(const ElementStream&) = delete;
+    ElementStream& operator=(const ElementStream&) = delete;
+    
+    // Counts a step that ended at the given Julian date, and queues a copy
+    // of particles on every decimation-th, waiting for room in the queue
+    // unless the stream is lossy.
+    void step(const Particles<T>& particles, long double julianDate);
+    
+    // Number of records dropped so far for want of room in the queue.
+    std::size_t dropped() const;
+
+private:
+    
+    struct Snapshot {
+        long double     date;
+        Particles<T>    particles;
+    };
+    
+    void write();
+    
+    std::ostream&               out_;
+    std::vector<std::string>    names_;
+    unsigned                    decimation_;
+    unsigned                    countdown_;
+    Centre                      centre_;
+    bool                        lossy_;
+    
+    mutable std::mutex          mutex_;
+    std::condition_variable     wake_;
+    std::condition_variable     room_;      // signalled when a copy leaves the queue
+    std::deque<Snapshot>        queue_;
+    std::vector<Particles<T>>   spare_;     // written copies, for reuse
+    std::size_t                 dropped_;
+    bool                        stop_;
+    std::thread                 writer_;
+};
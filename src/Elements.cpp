@@ -0,0 +1,162 @@
+//
+// exo
+// Elements.cpp - Structure-of-arrays orbital elements for whole populations.
+//
+#include <algorithm>
+#include <cmath>
+#include "Elements.hpp"
+#include "Orbit.hpp"
+#include "Physics.hpp"
+
+// Orbits per thread below which a conversion is not worth splitting.
+static const std::size_t GRAIN = 1024;
+
+template <typename T>
+void Elements<T>::resize(std::size_t count) {
+    for(auto* array : {&a_, &e_, &M_, &epoch_, &i_, &arg_, &raan_, &b_, &px_, &py_, &pz_, &qx_, &qy_, &qz_}) {
+        array->resize(count);
+    }
+}
+
+template <typename T>
+void Elements<T>::set(std::size_t k, W a, W e, W i, W arg, W raan, W M, W epoch) {
+    W cosO = std::cos(raan), sinO = std::sin(raan);
+    W cosw = std::cos(arg), sinw = std::sin(arg);
+    W cosi = std::cos(i), sini = std::sin(i);
+    
+    a_[k] = a;
+    e_[k] = e;
+    M_[k] = M;
+    epoch_[k] = epoch;
+    i_[k] = i;
+    arg_[k] = arg;
+    raan_[k] = raan;
+    b_[k] = std::abs(a) * std::sqrt(std::abs(1 - e * e));
+    px_[k] = cosO * cosw - sinO * sinw * cosi;
+    py_[k] = sinO * cosw + cosO * sinw * cosi;
+    pz_[k] = sinw * sini;
+    qx_[k] = -cosO * sinw - sinO * cosw * cosi;
+    qy_[k] = -sinO * sinw + cosO * cosw * cosi;
+    qz_[k] = cosw * sini;
+}
+
+template <typename T>
+void Elements<T>::push_back(W a, W e, W i, W arg, W raan, W M, W epoch) {
+    resize(size() + 1);
+    set(size() - 1, a, e, i, arg, raan, M, epoch);
+}
+
+template <typename T>
+void Elements<T>::stateVectors(const std::vector<W>& GM, long double julianDate,
+                               Particles<T>& particles, std::size_t first, ThreadPool& pool) const {
+    pool.run(size(), GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+        for(auto k = begin; k < end; ++k) {
+            W a = std::abs(a_[k]);
+            W e = e_[k];
+            W n = std::sqrt(GM[k] / (a * a * a));
+            W M = M_[k] + n * W((julianDate - (long double)epoch_[k]) * 86400);
+            
+            // Position and velocity in the perifocal frame.
+            W x, y, vx, vy;
+            if(e > 1 || a_[k] <= 0) {
+                W H = Orbit::hyperbolicAnomaly(M, e);
+                W sinhH = std::sinh(H), coshH = std::cosh(H);
+                W rate = n / (e * coshH - 1);
+                x = a * (e - coshH);
+                y = b_[k] * sinhH;
+                vx = -a * sinhH * rate;
+                vy = b_[k] * coshH * rate;
+            } else {
+                W E = Orbit::eccentricAnomaly(M, e);
+                W sinE = std::sin(E), cosE = std::cos(E);
+                W rate = n / (1 - e * cosE);
+                x = a * (cosE - e);
+                y = b_[k] * sinE;
+                vx = -a * sinE * rate;
+                vy = b_[k] * cosE * rate;
+            }
+            
+            particles.setPosition(first + k, vec3<W>{x * px_[k] + y * qx_[k],
+                                                     x * py_[k] + y * qy_[k],
+                                                     x * pz_[k] + y * qz_[k]});
+            particles.setVelocity(first + k, vec3<W>{vx * px_[k] + vy * qx_[k],
+                                                     vx * py_[k] + vy * qy_[k],
+                                                     vx * pz_[k] + vy * qz_[k]});
+        }
+    });
+}
+
+// Angle in [0, 2 pi).
+template <typename W>
+static W wrap(W angle) {
+    const W turn = 2 * std::acos(W(-1));
+    angle = std::fmod(angle, turn);
+    return angle < 0 ? angle + turn : angle;
+}
+
+template <typename T>
+void Elements<T>::osculating(const Particles<T>& particles, std::size_t first, Centre centre,
+                             long double julianDate, ThreadPool& pool) {
+    const W G = Physics::G;
+    vec3<W> position{}, velocity{};
+    W mass = 0;
+    if(centre == Centre::STAR) {
+        position = particles.position(0);
+        velocity = particles.velocity(0);
+    } else {
+        for(std::size_t i = 0; i < particles.size(); ++i) {
+            position += W(particles.mass[i]) * vec3<W>(particles.position(i));
+            velocity += W(particles.mass[i]) * vec3<W>(particles.velocity(i));
+            mass += particles.mass[i];
+        }
+        position /= mass;
+        velocity /= mass;
+    }
+    
+    const std::size_t count = particles.size() - std::min(first, particles.size());
+    resize(count);
+    pool.run(count, GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+        for(auto k = begin; k < end; ++k) {
+            auto i = first + k;
+            W mu = G * (centre == Centre::STAR ? W(particles.mass[0]) + particles.mass[i] : mass);
+            vec3<W> x = vec3<W>(particles.position(i)) - position;
+            vec3<W> v = vec3<W>(particles.velocity(i)) - velocity;
+            vec3<W> h = vec3<W>::cross(x, v);
+            W r = x.magnitude();
+            W hh = h.magnitude();
+            W hxy = std::sqrt(h.x * h.x + h.y * h.y);
+            
+            // e cos and e sin of the true anomaly, which give e and the
+            // anomaly without going through the eccentricity vector.
+            W ecos = hh * hh / (mu * r) - 1;
+            W esin = hh * vec3<W>::dot(x, v) / (mu * r);
+            W e = std::sqrt(ecos * ecos + esin * esin);
+            W a = 1 / (2 / r - vec3<W>::dot(v, v) / mu);
+            
+            // The ascending node is along x when the orbit lies in the x-y
+            // plane, and the argument of latitude is measured from it.
+            W cosO = hxy > 0 ? -h.y / hxy : W(1);
+            W sinO = hxy > 0 ? h.x / hxy : W(0);
+            W along = x.x * cosO + x.y * sinO;
+            W across = (h.z * (x.y * cosO - x.x * sinO) + hxy * x.z) / hh;
+            W latitude = std::atan2(across, along);
+            W f = std::atan2(esin, ecos);
+            
+            W M;
+            if(e < 1) {
+                W E = std::atan2(std::sqrt(1 - e * e) * esin, e * e + ecos);
+                M = E - e * std::sin(E);
+            } else {
+                W H = std::asinh(std::sqrt(e * e - 1) * esin / (e * (1 + ecos)));
+                M = e * std::sinh(H) - H;
+            }
+            
+            set(k, a, e, std::atan2(hxy, h.z), wrap(latitude - f), wrap(std::atan2(sinO, cosO)),
+                e < 1 ? wrap(M) : M, julianDate);
+        }
+    });
+}
+
+#define INSTANTIATE(T) template class Elements<T>;
+EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
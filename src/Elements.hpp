@@ -0,0 +1,79 @@
+//
+// exo
+// Elements.hpp - Structure-of-arrays orbital elements for whole populations.
+//
+// Orbit converts one body at a time, and works out the sines and cosines of
+// its angles again on every call. Here each element is one array, and each
+// orbit's rotation from its perifocal frame, where it lies in the x-y plane
+// with its periapsis along x, to the inertial frame is worked out once, when
+// the orbit is added. A conversion to state vectors then costs one Kepler
+// solve, a sine and a cosine per body, split across the threads of a pool.
+//
+// The other way, osculating() replaces the orbits with the ones bodies are
+// on at a given moment, the ellipse or hyperbola each would follow if the
+// rest of the system vanished, for analysing a run in terms of elements.
+//
+// Elements are kept in at least double, as Orbit's are in long double: a
+// float run still starts from well-placed bodies.
+//
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "Math/Scalar.hpp"
+#include "Particles.hpp"
+#include "ThreadPool.hpp"
+
+template <typename T>
+class Elements {
+public:
+    
+    typedef Scalar::Wide<T> W;
+    
+    // What osculating elements are measured from: body 0, each orbit about
+    // its mass plus the body's own, or the barycentre of all the particles,
+    // each orbit about their total mass.
+    enum class Centre {
+        STAR,
+        BARYCENTRE
+    };
+    
+    std::size_t size() const { return a_.size(); }
+    
+    // Adds an orbit. Angles are in radians, a is negative for hyperbolic
+    // orbits, and M is the mean anomaly at the Julian date epoch.
+    void push_back(W a, W e, W i, W arg, W raan, W M, W epoch);
+    
+    // Overwrites the positions and velocities of particles first to
+    // first + size() with those of the orbits at the given Julian date,
+    // each about a body of gravitational parameter GM[k] for orbit k.
+    void stateVectors(const std::vector<W>& GM, long double julianDate,
+                      Particles<T>& particles, std::size_t first, ThreadPool& pool) const;
+    
+    // Replaces the orbits with the osculating ones of particles first to
+    // the last, at the given Julian date, which becomes their epoch.
+    void osculating(const Particles<T>& particles, std::size_t first, Centre centre,
+                    long double julianDate, ThreadPool& pool);
+    
+    // Elements of orbit k, in the units push_back() takes. osculating()
+    // gives angles from 0 to 2 pi, but for the mean anomaly of a hyperbola.
+    W semiMajorAxis(std::size_t k) const { return a_[k]; }
+    W eccentricity(std::size_t k) const { return e_[k]; }
+    W inclination(std::size_t k) const { return i_[k]; }
+    W argOfPeriapsis(std::size_t k) const { return arg_[k]; }
+    W rightAscension(std::size_t k) const { return raan_[k]; }
+    W meanAnomaly(std::size_t k) const { return M_[k]; }
+    W epoch(std::size_t k) const { return epoch_[k]; }
+    
+private:
+    
+    void resize(std::size_t count);
+    
+    // Sets orbit k, as push_back() adds one.
+    void set(std::size_t k, W a, W e, W i, W arg, W raan, W M, W epoch);
+    
+    std::vector<W>  a_, e_, M_, epoch_;
+    std::vector<W>  i_, arg_, raan_;
+    std::vector<W>  b_;             // semi-minor axis, |a| sqrt(|1 - e^2|)
+    std::vector<W>  px_, py_, pz_;  // unit vector towards periapsis
+    std::vector<W>  qx_, qy_, qz_;  // unit vector along the velocity there
+};
@@ -0,0 +1,458 @@
+//
+// exo
+// Fmm.cpp - Cartesian Fast Multipole Method gravity solver.
+//
+// With phi(x) = sum m_j / |x - y_j|, the acceleration is G grad(phi). For a
+// source cell centred on s and a target cell centred on t, R = t - s:
+//
+//   multipole   M_n = sum m_j (s - y_j)^n / n!
+//   local       L_m = 1/m! sum_n D^(m+n)(1/|R|) M_n
+//   potential   phi(t + e) = sum_m L_m e^m
+//
+// where n, m are multi-indices of degree up to the expansion order. Cells
+// are centred on their centre of mass rather than their cube, so the dipole
+// term vanishes and a heavy body, a star among its belt, sits at the centre
+// of its cells instead of being carried by the high-order terms. Bodies
+// heavier than a share of the whole system are left out of the expansions
+// altogether and pull on every body directly: no cell around them is small
+// enough for a local expansion to carry their pull to its bodies as closely
+// as the direct sum does.
+//
+#include <cmath>
+#include <algorithm>
+#include "Fmm.hpp"
+#include "Physics.hpp"
+
+static const uint32_t LEAF_SIZE = 64;
+static const std::size_t GRAIN = 4;
+
+// Share of the total mass above which a body is summed directly.
+static const double HEAVY = 0.01;
+
+template <typename T>
+Fmm<T>::Fmm(int order, double theta)
+: order_(std::max(order, 0))
+, theta_(theta)
+, tree_(LEAF_SIZE) {
+    
+    const int top = 2 * order_;
+    const int side = top + 1;
+    coefficients_ = (order_ + 1) * (order_ + 2) * (order_ + 3) / 6;
+    lookup_.assign(side * side * side, -1);
+    
+    // Terms are sorted by degree, so the first coefficients_ of them are the
+    // ones an expansion of the given order needs.
+    for(int degree = 0; degree <= top; ++degree) {
+        for(int i = degree; i >= 0; --i) {
+            for(int j = degree - i; j >= 0; --j) {
+                Term t;
+                t.n[0] = i;
+                t.n[1] = j;
+                t.n[2] = degree - i - j;
+                t.degree = degree;
+                lookup_[(t.n[0] * side + t.n[1]) * side + t.n[2]] = terms_.size();
+                terms_.push_back(t);
+            }
+        }
+    }
+    
+    for(auto& t : terms_) {
+        t.axis = -1;
+        t.factorial = 1;
+        for(int a = 2; a >= 0; --a) {
+            int n[3] = {t.n[0], t.n[1], t.n[2]};
+            n[a] -= 1;
+            t.lower[a] = n[a] >= 0 ? term(n[0], n[1], n[2]) : -1;
+            n[a] -= 1;
+            t.lower2[a] = n[a] >= 0 ? term(n[0], n[1], n[2]) : -1;
+            if(t.n[a] > 0) { t.axis = a; }
+            for(int f = 2; f <= t.n[a]; ++f) { t.factorial *= f; }
+        }
+    }
+    
+    for(int to = 0; to < coefficients_; ++to) {
+        for(int from = 0; from < coefficients_; ++from) {
+            const auto& a = terms_[to].n;
+            const auto& b = terms_[from].n;
+            if(b[0] > a[0] || b[1] > a[1] || b[2] > a[2]) { continue; }
+            int by = term(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+            shifts_.push_back(Shift{to, from, by,
+                terms_[to].factorial / (terms_[from].factorial * terms_[by].factorial)});
+        }
+    }
+    
+    sums_.resize(coefficients_ * coefficients_);
+    for(int m = 0; m < coefficients_; ++m) {
+        for(int n = 0; n < coefficients_; ++n) {
+            const auto& a = terms_[m].n;
+            const auto& b = terms_[n].n;
+            sums_[m * coefficients_ + n] = term(a[0] + b[0], a[1] + b[1], a[2] + b[2]);
+        }
+    }
+}
+
+template <typename T>
+int Fmm<T>::term(int i, int j, int k) const {
+    const int side = 2 * order_ + 1;
+    return lookup_[(i * side + j) * side + k];
+}
+
+// Fills out with d^n for the first count terms.
+template <typename T>
+void Fmm<T>::monomials(W dx, W dy, W dz, int count, W* out) const {
+    const W d[3] = {dx, dy, dz};
+    out[0] = 1;
+    for(int t = 1; t < count; ++t) {
+        const auto& term = terms_[t];
+        out[t] = out[term.lower[term.axis]] * d[term.axis];
+    }
+}
+
+// Fills out with the derivatives D^n(1/|R|) for every term, using the
+// recurrence on the Taylor coefficients b_n = D^n(1/|R|) / n!:
+//
+//   |n| R^2 b_n = -(2|n| - 1) sum_i R_i b_(n-e_i) - (|n| - 1) sum_i b_(n-2e_i)
+template <typename T>
+void Fmm<T>::derivatives(W rx, W ry, W rz, W* out) const {
+    const W R[3] = {rx, ry, rz};
+    const W r2 = rx*rx + ry*ry + rz*rz;
+    const int count = terms_.size();
+    
+    out[0] = 1 / std::sqrt(r2);
+    for(int t = 1; t < count; ++t) {
+        const auto& term = terms_[t];
+        W first = 0, second = 0;
+        for(int a = 0; a < 3; ++a) {
+            if(term.lower[a] >= 0) { first += R[a] * out[term.lower[a]]; }
+            if(term.lower2[a] >= 0) { second += out[term.lower2[a]]; }
+        }
+        out[t] = -((2 * term.degree - 1) * first + (term.degree - 1) * second) / (term.degree * r2);
+    }
+    for(int t = 0; t < count; ++t) {
+        out[t] *= terms_[t].factorial;
+    }
+}
+
+template <typename T>
+void Fmm<T>::upward() {
+    const auto& cells = tree_.cells();
+    const int C = coefficients_;
+    std::vector<W> mono(C);
+    
+    radius_.assign(cells.size(), 0);
+    centres_.assign(cells.size() * 3, 0);
+    masses_.assign(cells.size(), 0);
+    multipoles_.assign(cells.size() * C, 0);
+    
+    // Children are stored after their parent, so a backward sweep has every
+    // child's centre and expansion ready before its parent needs them.
+    for(auto c = cells.size(); c-- > 0;) {
+        const auto& cell = cells[c];
+        auto* M = &multipoles_[c * C];
+        auto* centre = &centres_[c * 3];
+        
+        W mass = 0;
+        if(cell.leaf) {
+            for(auto k = cell.begin; k < cell.end; ++k) {
+                mass += tree_.mass[k];
+                centre[0] += W(tree_.mass[k]) * tree_.x[k];
+                centre[1] += W(tree_.mass[k]) * tree_.y[k];
+                centre[2] += W(tree_.mass[k]) * tree_.z[k];
+            }
+        } else {
+            for(auto child = c + 1; child < cell.next; child = cells[child].next) {
+                const auto* cc = &centres_[child * 3];
+                mass += masses_[child];
+                centre[0] += masses_[child] * cc[0];
+                centre[1] += masses_[child] * cc[1];
+                centre[2] += masses_[child] * cc[2];
+            }
+        }
+        
+        // Cells with no mass are given their geometric centre, so that they
+        // are still well-formed.
+        masses_[c] = mass;
+        if(mass > 0) {
+            centre[0] /= mass;
+            centre[1] /= mass;
+            centre[2] /= mass;
+        } else {
+            centre[0] = cell.x;
+            centre[1] = cell.y;
+            centre[2] = cell.z;
+        }
+        
+        if(cell.leaf) {
+            for(auto k = cell.begin; k < cell.end; ++k) {
+                W dx = tree_.x[k] - centre[0];
+                W dy = tree_.y[k] - centre[1];
+                W dz = tree_.z[k] - centre[2];
+                radius_[c] = std::max(radius_[c], std::sqrt(dx*dx + dy*dy + dz*dz));
+                
+                monomials(-dx, -dy, -dz, C, mono.data());
+                for(int n = 0; n < C; ++n) {
+                    M[n] += tree_.mass[k] * mono[n] / terms_[n].factorial;
+                }
+            }
+            continue;
+        }
+        
+        for(auto child = c + 1; child < cell.next; child = cells[child].next) {
+            const auto* cc = &centres_[child * 3];
+            W sx = cc[0] - centre[0];
+            W sy = cc[1] - centre[1];
+            W sz = cc[2] - centre[2];
+            radius_[c] = std::max(radius_[c], std::sqrt(sx*sx + sy*sy + sz*sz) + radius_[child]);
+            
+            const auto* Mc = &multipoles_[child * C];
+            monomials(-sx, -sy, -sz, C, mono.data());
+            for(const auto& s : shifts_) {
+                M[s.to] += Mc[s.from] * mono[s.by] / terms_[s.by].factorial;
+            }
+        }
+    }
+}
+
+// Dual tree walk: sorts every pair of cells into well-separated pairs, which
+// interact through their expansions, and pairs of leaves summed directly.
+template <typename T>
+void Fmm<T>::interact(uint32_t a, uint32_t b) {
+    const auto& cells = tree_.cells();
+    const auto& A = cells[a];
+    const auto& B = cells[b];
+    
+    if(a == b) {
+        if(A.leaf) {
+            near_.push_back(std::make_pair(a, a));
+            return;
+        }
+        for(auto c1 = a + 1; c1 < A.next; c1 = cells[c1].next) {
+            for(auto c2 = c1; c2 < A.next; c2 = cells[c2].next) {
+                interact(c1, c2);
+            }
+        }
+        return;
+    }
+    
+    const auto* ca = &centres_[a * 3];
+    const auto* cb = &centres_[b * 3];
+    W dx = ca[0] - cb[0];
+    W dy = ca[1] - cb[1];
+    W dz = ca[2] - cb[2];
+    W distance = std::sqrt(dx*dx + dy*dy + dz*dz);
+    
+    if(radius_[a] + radius_[b] < theta_ * distance) {
+        far_.push_back(std::make_pair(a, b));
+        far_.push_back(std::make_pair(b, a));
+        return;
+    }
+    
+    if(A.leaf && B.leaf) {
+        near_.push_back(std::make_pair(a, b));
+        near_.push_back(std::make_pair(b, a));
+        return;
+    }
+    
+    // Split the larger of the two cells.
+    if(!A.leaf && (B.leaf || radius_[a] >= radius_[b])) {
+        for(auto child = a + 1; child < A.next; child = cells[child].next) {
+            interact(child, b);
+        }
+    } else {
+        for(auto child = b + 1; child < B.next; child = cells[child].next) {
+            interact(a, child);
+        }
+    }
+}
+
+// Counting sort of (target, source) pairs by target: the sources of cell c
+// end up in sources[start[c]] to sources[start[c+1]].
+template <typename T>
+void Fmm<T>::group(const std::vector<std::pair<uint32_t, uint32_t>>& pairs, std::size_t cells,
+                   std::vector<uint32_t>& start, std::vector<uint32_t>& sources) {
+    start.assign(cells + 1, 0);
+    for(const auto& pair : pairs) {
+        start[pair.first + 1] += 1;
+    }
+    for(std::size_t c = 0; c < cells; ++c) {
+        start[c + 1] += start[c];
+    }
+    sources.resize(pairs.size());
+    std::vector<uint32_t> next(start.begin(), start.end() - 1);
+    for(const auto& pair : pairs) {
+        sources[next[pair.first]++] = pair.second;
+    }
+}
+
+template <typename T>
+void Fmm<T>::farField(ThreadPool& pool) {
+    const auto& cells = tree_.cells();
+    const int C = coefficients_;
+    
+    locals_.assign(cells.size() * C, 0);
+    
+    pool.run(cells.size(), GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+        std::vector<W> D(terms_.size());
+        
+        for(auto t = begin; t < end; ++t) {
+            const auto* target = &centres_[t * 3];
+            auto* L = &locals_[t * C];
+            
+            for(auto s = farStart_[t]; s < farStart_[t + 1]; ++s) {
+                const auto* source = &centres_[farSources_[s] * 3];
+                const auto* M = &multipoles_[farSources_[s] * C];
+                
+                derivatives(target[0] - source[0], target[1] - source[1], target[2] - source[2], D.data());
+                for(int m = 0; m < C; ++m) {
+                    const int* sum = &sums_[m * C];
+                    W l = 0;
+                    for(int n = 0; n < C; ++n) {
+                        l += D[sum[n]] * M[n];
+                    }
+                    L[m] += l / terms_[m].factorial;
+                }
+            }
+        }
+    });
+}
+
+template <typename T>
+void Fmm<T>::downward() {
+    const auto& cells = tree_.cells();
+    const int C = coefficients_;
+    std::vector<W> mono(C);
+    
+    // Parents come before their children, so a forward sweep has every local
+    // expansion complete before it is passed down.
+    for(uint32_t c = 0; c < cells.size(); ++c) {
+        const auto& cell = cells[c];
+        if(cell.leaf) { continue; }
+        const auto* L = &locals_[c * C];
+        const auto* centre = &centres_[c * 3];
+        
+        for(auto child = c + 1; child < cell.next; child = cells[child].next) {
+            auto* Lc = &locals_[child * C];
+            const auto* cc = &centres_[child * 3];
+            monomials(cc[0] - centre[0], cc[1] - centre[1], cc[2] - centre[2], C, mono.data());
+            for(const auto& s : shifts_) {
+                Lc[s.from] += L[s.to] * s.binomial * mono[s.by];
+            }
+        }
+    }
+}
+
+template <typename T>
+void Fmm<T>::evaluate(Particles<T>& particles, ThreadPool& pool) {
+    const W G = Physics::G;
+    const auto& cells = tree_.cells();
+    const auto& order = tree_.order();
+    const auto* x = tree_.x.data();
+    const auto* y = tree_.y.data();
+    const auto* z = tree_.z.data();
+    const auto* mass = tree_.mass.data();
+    const int C = coefficients_;
+    const auto count = particles.size();
+    
+    ax_.resize(count);
+    ay_.resize(count);
+    az_.resize(count);
+    
+    // Every body belongs to exactly one leaf, so threads working on different
+    // leaves never write to the same body.
+    pool.run(cells.size(), GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+        std::vector<W> mono(C);
+        
+        for(auto c = begin; c < end; ++c) {
+            const auto& cell = cells[c];
+            if(!cell.leaf) { continue; }
+            const auto* L = &locals_[c * C];
+            const auto* centre = &centres_[c * 3];
+            
+            for(auto k = cell.begin; k < cell.end; ++k) {
+                monomials(x[k] - centre[0], y[k] - centre[1], z[k] - centre[2], C, mono.data());
+                W g[3] = {0, 0, 0};
+                for(int m = 1; m < C; ++m) {
+                    const auto& term = terms_[m];
+                    for(int a = 0; a < 3; ++a) {
+                        if(term.n[a] == 0) { continue; }
+                        g[a] += L[m] * term.n[a] * mono[term.lower[a]];
+                    }
+                }
+                
+                for(std::size_t n = 0; n < heavy_.size(); ++n) {
+                    auto h = heavy_[n];
+                    if(h == k) { continue; }
+                    W dx = W(x[h]) - x[k];
+                    W dy = W(y[h]) - y[k];
+                    W dz = W(z[h]) - z[k];
+                    W invR = 1 / std::sqrt(dx*dx + dy*dy + dz*dz);
+                    W invR3 = heavyMass_[n] * invR * invR * invR;
+                    g[0] += invR3 * dx;
+                    g[1] += invR3 * dy;
+                    g[2] += invR3 * dz;
+                }
+                
+                for(auto s = nearStart_[c]; s < nearStart_[c + 1]; ++s) {
+                    const auto& source = cells[nearSources_[s]];
+                    for(auto j = source.begin; j < source.end; ++j) {
+                        if(j == k || mass[j] == 0) { continue; }
+                        W dx = W(x[j]) - x[k];
+                        W dy = W(y[j]) - y[k];
+                        W dz = W(z[j]) - z[k];
+                        W invR = 1 / std::sqrt(dx*dx + dy*dy + dz*dz);
+                        W invR3 = mass[j] * invR * invR * invR;
+                        g[0] += invR3 * dx;
+                        g[1] += invR3 * dy;
+                        g[2] += invR3 * dz;
+                    }
+                }
+                
+                ax_[k] = G * g[0];
+                ay_[k] = G * g[1];
+                az_[k] = G * g[2];
+            }
+        }
+    });
+    
+    for(uint32_t k = 0; k < count; ++k) {
+        auto i = order[k];
+        particles.ax[i] = ax_[k];
+        particles.ay[i] = ay_[k];
+        particles.az[i] = az_[k];
+    }
+}
+
+template <typename T>
+void Fmm<T>::accelerate(Particles<T>& particles, ThreadPool& pool) {
+    if(particles.size() == 0) { return; }
+    
+    tree_.build(particles);
+    
+    // Heavy bodies stay in the tree as targets, but with no mass.
+    W total = 0;
+    for(auto m : tree_.mass) { total += m; }
+    heavy_.clear();
+    heavyMass_.clear();
+    for(uint32_t k = 0; k < tree_.mass.size(); ++k) {
+        if(tree_.mass[k] > HEAVY * total) {
+            heavy_.push_back(k);
+            heavyMass_.push_back(tree_.mass[k]);
+            tree_.mass[k] = 0;
+        }
+    }
+    
+    upward();
+    
+    far_.clear();
+    near_.clear();
+    interact(0, 0);
+    group(far_, tree_.cells().size(), farStart_, farSources_);
+    group(near_, tree_.cells().size(), nearStart_, nearSources_);
+    
+    farField(pool);
+    downward();
+    evaluate(particles, pool);
+}
+
+#define INSTANTIATE(T) template class Fmm<T>;
+EXO_INSTANTIATE_SCALARS(INSTANTIATE)
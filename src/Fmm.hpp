@@ -0,0 +1,96 @@
+//
+// exo
+// Fmm.hpp - Cartesian Fast Multipole Method gravity solver.
+//
+// Cells of an octree carry Taylor multipole expansions of their mass about
+// their centre of mass, built bottom-up. Well-separated pairs of cells, found by a dual tree walk,
+// exchange those as local expansions, which are then pushed top-down to the
+// bodies; everything else is summed directly, as is the pull of any body
+// that dominates the system's mass, such as a star. The cost of a force
+// pass is O(N), and the expansion order sets the accuracy.
+//
+#pragma once
+#include <utility>
+#include <vector>
+#include "Gravity.hpp"
+#include "Octree.hpp"
+
+template <typename T>
+class Fmm : public Gravity<T> {
+public:
+    
+    Fmm(int order, double theta);
+    
+    void accelerate(Particles<T>& particles, ThreadPool& pool) override;
+    
+private:
+    
+    // Expansions are kept in at least double, as mass moments overflow a
+    // float.
+    typedef Scalar::Wide<T> W;
+    
+    // A multi-index n = (i, j, k) and the indices of its neighbours in the
+    // table, used to build monomials and derivatives by recurrence.
+    struct Term {
+        int         n[3];
+        int         degree;
+        int         axis;       // first non-zero component
+        int         lower[3];   // term n - e_i, or -1
+        int         lower2[3];  // term n - 2e_i, or -1
+        W           factorial;  // n! = i! j! k!
+    };
+    
+    // Term to = from + by, and the multinomial to! / (from! by!), used to
+    // translate expansions from one centre to another.
+    struct Shift {
+        int         to, from, by;
+        W           binomial;
+    };
+    
+    int term(int i, int j, int k) const;
+    
+    void monomials(W dx, W dy, W dz, int count, W* out) const;
+    
+    void derivatives(W rx, W ry, W rz, W* out) const;
+    
+    void upward();
+    
+    void interact(uint32_t a, uint32_t b);
+    
+    static void group(const std::vector<std::pair<uint32_t, uint32_t>>& pairs, std::size_t cells,
+                      std::vector<uint32_t>& start, std::vector<uint32_t>& sources);
+    
+    void farField(ThreadPool& pool);
+    
+    void downward();
+    
+    void evaluate(Particles<T>& particles, ThreadPool& pool);
+    
+    int                         order_;
+    double                      theta_;
+    int                         coefficients_;  // terms of degree <= order
+    std::vector<Term>           terms_;         // terms of degree <= 2*order
+    std::vector<int>            lookup_;
+    std::vector<Shift>          shifts_;
+    std::vector<int>            sums_;          // term m + n, for m, n <= order
+    
+    Octree<T>                   tree_;
+    std::vector<W>              radius_;
+    std::vector<W>              centres_;       // expansion centre of each cell, x y z
+    std::vector<W>              masses_;
+    std::vector<W>              multipoles_;
+    std::vector<W>              locals_;
+    
+    // (target, source) cell pairs from the dual tree walk, then the same
+    // grouped by target cell so that targets can be processed in parallel.
+    std::vector<std::pair<uint32_t, uint32_t>> far_;
+    std::vector<std::pair<uint32_t, uint32_t>> near_;
+    std::vector<uint32_t>       farStart_, farSources_;
+    std::vector<uint32_t>       nearStart_, nearSources_;
+    
+    std::vector<W>              ax_, ay_, az_;  // accelerations in tree order
+    
+    // Bodies summed directly, in tree order, and their masses.
+    std::vector<uint32_t>       heavy_;
+    std::vector<W>              heavyMass_;
+};
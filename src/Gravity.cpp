@@ -0,0 +1,266 @@
+//
+// exo
+// Gravity.cpp - Gravity solver selection and the direct sum.
+//
+#include <algorithm>
+#include <cmath>
+#include "Gravity.hpp"
+#include "BarnesHut.hpp"
+#include "Fmm.hpp"
+#include "SimdDirect.hpp"
+#include "Physics.hpp"
+
+template <typename T>
+std::unique_ptr<Gravity<T>> Gravity<T>::named(const std::string& name, const Config& config) {
+    if(name == "direct") {
+        return std::unique_ptr<Gravity>(new DirectSum<T>());
+    }
+    if(name == "tree") {
+        return std::unique_ptr<Gravity>(new BarnesHut<T>(config.theta, config.quadrupole));
+    }
+    if(name == "fmm") {
+        return std::unique_ptr<Gravity>(new Fmm<T>(config.order, config.theta));
+    }
+    if(name == "simd") {
+        return std::unique_ptr<Gravity>(new SimdDirect<T, double>());
+    }
+    if(name == "simd-float") {
+        return std::unique_ptr<Gravity>(new SimdDirect<T, float>());
+    }
+    return nullptr;
+}
+
+template <typename T>
+void Gravity<T>::accelerateSubset(Particles<T>& particles, const std::vector<uint32_t>& active, ThreadPool& pool) {
+    Particles<T> copy = particles;
+    accelerate(copy, pool);
+    for(auto i : active) {
+        particles.setAcceleration(i, copy.acceleration(i));
+    }
+}
+
+// Pairs per thread below which jerk passes are not worth splitting.
+static const std::size_t JERK_GRAIN = 32768;
+
+template <typename T>
+void Gravity<T>::accelerateWithJerk(Particles<T>& particles, const std::vector<uint32_t>& active,
+                                    Jerks<T>& jerks, ThreadPool& pool) {
+    typedef Scalar::Wide<T> W;
+    const W G = Physics::G;
+    const auto count = particles.size();
+    const auto grain = std::max<std::size_t>(1, JERK_GRAIN / (count + 1));
+    jerks.x.resize(count);
+    jerks.y.resize(count);
+    jerks.z.resize(count);
+    
+    pool.run(active.size(), grain, [&](std::size_t begin, std::size_t end, unsigned) {
+        for(auto k = begin; k < end; ++k) {
+            auto i = active[k];
+            W ax = 0, ay = 0, az = 0;
+            W jx = 0, jy = 0, jz = 0;
+            
+            for(std::size_t j = 0; j < count; ++j) {
+                if(j == i || particles.mass[j] == 0) { continue; }
+                W dx = W(particles.x[j]) - particles.x[i];
+                W dy = W(particles.y[j]) - particles.y[i];
+                W dz = W(particles.z[j]) - particles.z[i];
+                W dvx = W(particles.vx[j]) - particles.vx[i];
+                W dvy = W(particles.vy[j]) - particles.vy[i];
+                W dvz = W(particles.vz[j]) - particles.vz[i];
+                
+                W invR2 = 1 / (dx*dx + dy*dy + dz*dz);
+                W invR3 = G * particles.mass[j] * invR2 * std::sqrt(invR2);
+                W rv = 3 * (dx*dvx + dy*dvy + dz*dvz) * invR2;
+                ax += invR3 * dx;
+                ay += invR3 * dy;
+                az += invR3 * dz;
+                jx += invR3 * (dvx - rv * dx);
+                jy += invR3 * (dvy - rv * dy);
+                jz += invR3 * (dvz - rv * dz);
+            }
+            
+            particles.setAcceleration(i, vec3<W>{ax, ay, az});
+            jerks.x[i] = jx;
+            jerks.y[i] = jy;
+            jerks.z[i] = jz;
+        }
+    });
+}
+
+template <typename T>
+typename Gravity<T>::Error Gravity<T>::error(const Particles<T>& particles, std::size_t samples, ThreadPool& pool) {
+    // The reference is summed in at least long double.
+    typedef decltype(T() * 1.0L) R;
+    
+    Error error{0, 0};
+    const auto count = particles.size();
+    if(count == 0 || samples == 0) { return error; }
+    
+    Particles<T> approximate = particles;
+    accelerate(approximate, pool);
+    
+    samples = std::min(samples, count);
+    for(std::size_t s = 0; s < samples; ++s) {
+        auto i = s * count / samples;
+        R ax = 0, ay = 0, az = 0;
+        
+        for(std::size_t j = 0; j < count; ++j) {
+            if(j == i) { continue; }
+            R dx = R(particles.x[j]) - particles.x[i];
+            R dy = R(particles.y[j]) - particles.y[i];
+            R dz = R(particles.z[j]) - particles.z[i];
+            R invR = 1 / std::sqrt(dx*dx + dy*dy + dz*dz);
+            R invR3 = R(Physics::G) * particles.mass[j] * invR * invR * invR;
+            ax += invR3 * dx;
+            ay += invR3 * dy;
+            az += invR3 * dz;
+        }
+        
+        R ex = approximate.ax[i] - ax;
+        R ey = approximate.ay[i] - ay;
+        R ez = approximate.az[i] - az;
+        double e = (double)std::sqrt((ex*ex + ey*ey + ez*ez) / (ax*ax + ay*ay + az*az));
+        error.mean += e / samples;
+        error.max = std::max(error.max, e);
+    }
+    return error;
+}
+
+static const std::size_t GRAIN = 256;
+
+// First row of the pair triangle i < j that a thread starts at, so that every
+// thread gets the same number of pairs rather than the same number of rows.
+// Only the first rows rows are shared out.
+static std::size_t firstRow(std::size_t count, std::size_t rows, unsigned threads, unsigned thread) {
+    double n = count;
+    double r = rows;
+    double pairs = 0.5 * r * (2 * n - 1 - r) * thread / threads;
+    double b = 2 * n - 1;
+    double row = 0.5 * (b - std::sqrt(std::max(0.0, b * b - 8 * pairs)));
+    return std::min<std::size_t>(rows, std::llround(row));
+}
+
+template <typename T>
+void DirectSum<T>::accelerate(Particles<T>& particles, ThreadPool& pool) {
+    typedef Scalar::Wide<T> W;
+    const W G = Physics::G;
+    const auto count = particles.size();
+    const auto threads = pool.threadsFor(count, GRAIN);
+    const auto* x = particles.x.data();
+    const auto* y = particles.y.data();
+    const auto* z = particles.z.data();
+    const auto* m = particles.mass.data();
+    
+    // Rows past the last body with mass only pair massless bodies.
+    auto rows = count;
+    while(rows > 0 && m[rows - 1] == 0) { --rows; }
+    
+    ax_.resize(threads);
+    ay_.resize(threads);
+    az_.resize(threads);
+    
+    pool.run(threads, 1, [&](std::size_t begin, std::size_t end, unsigned) {
+        for(auto thread = begin; thread < end; ++thread) {
+            std::vector<T>* buffers[3] = {&particles.ax, &particles.ay, &particles.az};
+            if(thread > 0) {
+                ax_[thread].resize(count);
+                ay_[thread].resize(count);
+                az_[thread].resize(count);
+                buffers[0] = &ax_[thread];
+                buffers[1] = &ay_[thread];
+                buffers[2] = &az_[thread];
+            }
+            auto* ax = buffers[0]->data();
+            auto* ay = buffers[1]->data();
+            auto* az = buffers[2]->data();
+            
+            std::fill(ax, ax + count, 0.0);
+            std::fill(ay, ay + count, 0.0);
+            std::fill(az, az + count, 0.0);
+            
+            auto last = firstRow(count, rows, threads, thread + 1);
+            for(auto i = firstRow(count, rows, threads, thread); i < last; ++i) {
+                W axi = 0, ayi = 0, azi = 0;
+                
+                for(std::size_t j = i + 1; j < count; ++j) {
+                    W dx = W(x[j]) - x[i];
+                    W dy = W(y[j]) - y[i];
+                    W dz = W(z[j]) - z[i];
+                    
+                    W invR = 1 / std::sqrt(dx*dx + dy*dy + dz*dz);
+                    W invR3 = G * invR * invR * invR;
+                    
+                    // i is pulled towards j, and j towards i
+                    axi += m[j] * invR3 * dx;
+                    ayi += m[j] * invR3 * dy;
+                    azi += m[j] * invR3 * dz;
+                    ax[j] -= m[i] * invR3 * dx;
+                    ay[j] -= m[i] * invR3 * dy;
+                    az[j] -= m[i] * invR3 * dz;
+                }
+                
+                ax[i] += axi;
+                ay[i] += ayi;
+                az[i] += azi;
+            }
+        }
+    });
+    
+    if(threads == 1) { return; }
+    
+    pool.run(count, GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+        for(unsigned thread = 1; thread < threads; ++thread) {
+            for(auto i = begin; i < end; ++i) {
+                particles.ax[i] += ax_[thread][i];
+                particles.ay[i] += ay_[thread][i];
+                particles.az[i] += az_[thread][i];
+            }
+        }
+    });
+}
+
+template <typename T>
+void DirectSum<T>::accelerateSubset(Particles<T>& particles, const std::vector<uint32_t>& active, ThreadPool& pool) {
+    typedef Scalar::Wide<T> W;
+    const W G = Physics::G;
+    const auto count = particles.size();
+    const auto* x = particles.x.data();
+    const auto* y = particles.y.data();
+    const auto* z = particles.z.data();
+    const auto* m = particles.mass.data();
+    
+    sources_.clear();
+    for(uint32_t j = 0; j < count; ++j) {
+        if(m[j] != 0) { sources_.push_back(j); }
+    }
+    
+    // Rows per thread, so that each gets about as many pairs as in a full pass.
+    const auto grain = std::max<std::size_t>(1, GRAIN * GRAIN / (2 * sources_.size() + 1));
+    
+    pool.run(active.size(), grain, [&](std::size_t begin, std::size_t end, unsigned) {
+        for(auto k = begin; k < end; ++k) {
+            auto i = active[k];
+            W axi = 0, ayi = 0, azi = 0;
+            
+            for(auto j : sources_) {
+                if(j == i) { continue; }
+                W dx = W(x[j]) - x[i];
+                W dy = W(y[j]) - y[i];
+                W dz = W(z[j]) - z[i];
+                
+                W invR = 1 / std::sqrt(dx*dx + dy*dy + dz*dz);
+                W invR3 = G * m[j] * invR * invR * invR;
+                axi += invR3 * dx;
+                ayi += invR3 * dy;
+                azi += invR3 * dz;
+            }
+            
+            particles.ax[i] = axi;
+            particles.ay[i] = ayi;
+            particles.az[i] = azi;
+        }
+    });
+}
+
+#define INSTANTIATE(T) template class Gravity<T>; template class DirectSum<T>;
+EXO_INSTANTIATE_SCALARS(INSTANTIATE)
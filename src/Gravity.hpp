@@ -0,0 +1,94 @@
+//
+// exo
+// Gravity.hpp - Interchangeable gravity solvers.
+//
+// A solver fills in the acceleration of every body in a Particles set from
+// their positions and masses. The direct sum is exact and stays the reference
+// for small systems; the approximate solvers trade accuracy for speed when
+// there are too many bodies for O(N^2).
+//
+// Bodies with no mass are test particles. They are pulled but pull on
+// nothing, and the direct sums skip them as sources, so a pass over M massive
+// bodies and N test particles costs O(M (M + N)), best with the massive ones
+// first.
+//
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Particles.hpp"
+#include "ThreadPool.hpp"
+
+// Tuning knobs for the approximate solvers, ignored by the direct sum.
+struct GravityConfig {
+    double      theta       = 0.5;      // opening angle of tree cells
+    bool        quadrupole  = false;    // use quadrupole cell moments
+    int         order       = 4;        // multipole expansion order
+};
+
+// Time derivatives of the accelerations of a set of bodies, one array per
+// component.
+template <typename T>
+struct Jerks {
+    std::vector<T>  x, y, z;
+};
+
+// Relative acceleration error against the direct sum.
+struct GravityError {
+    double      mean;
+    double      max;
+};
+
+template <typename T>
+class Gravity {
+public:
+    
+    typedef GravityConfig   Config;
+    typedef GravityError    Error;
+    
+    virtual ~Gravity() {}
+    
+    // Overwrites the acceleration of every body in the set, splitting the
+    // work across the pool's threads.
+    virtual void accelerate(Particles<T>& particles, ThreadPool& pool) = 0;
+    
+    // Overwrites the acceleration of the listed bodies only, as pulled by
+    // every body in the set. Solvers that cannot do better run a full pass
+    // on a copy of the set.
+    virtual void accelerateSubset(Particles<T>& particles, const std::vector<uint32_t>& active, ThreadPool& pool);
+    
+    // Overwrites the accelerations and jerks of the listed bodies, as pulled
+    // by every body in the set, from their positions and velocities. Both
+    // are summed exactly, pair by pair, whatever the solver: the jerk terms
+    // come almost for free with each pair's acceleration.
+    void accelerateWithJerk(Particles<T>& particles, const std::vector<uint32_t>& active,
+                            Jerks<T>& jerks, ThreadPool& pool);
+    
+    // Runs the solver on a copy of the set and compares it with the direct
+    // sum on an evenly spread sample of bodies.
+    Error error(const Particles<T>& particles, std::size_t samples, ThreadPool& pool);
+    
+    // Returns the solver called name ("direct", "tree", "fmm", "simd",
+    // "simd-float"), or nullptr if there is no such solver.
+    static std::unique_ptr<Gravity> named(const std::string& name, const Config& config);
+};
+
+// Exact O(N^2) pairwise summation. Each pair is visited once and receives
+// equal and opposite contributions.
+template <typename T>
+class DirectSum : public Gravity<T> {
+public:
+    void accelerate(Particles<T>& particles, ThreadPool& pool) override;
+    
+    // Sums every body's pull on each listed body. Pairs are not shared, as
+    // most of the bodies pulling are not in the list.
+    void accelerateSubset(Particles<T>& particles, const std::vector<uint32_t>& active, ThreadPool& pool) override;
+    
+private:
+    // Accumulators for threads other than the first, which writes straight
+    // into the particles; they are summed once every pair is done.
+    std::vector<std::vector<T>> ax_, ay_, az_;
+    std::vector<uint32_t>       sources_;   // bodies with mass
+};
@@ -0,0 +1,127 @@
+//
+// exo
+// Hermite.cpp - Fourth-order Hermite predictor-corrector scheme.
+//
+#include <algorithm>
+#include <cmath>
+#include "Hermite.hpp"
+
+namespace Integrator {
+    
+    // Accuracy parameters of Aarseth's criterion, and of the first step,
+    // which can only use the acceleration and jerk. Cluster codes use about
+    // 0.01; planets are followed over many more orbits.
+    static const double ETA = 0.001;
+    static const double ETA_START = 0.001;
+    
+    template <typename T>
+    void Hermite<T>::start(Particles<T>& particles, const Forces<T>& forces) {
+        typedef Scalar::Wide<T> W;
+        const auto count = particles.size();
+        predicted_ = particles;
+        levels_.assign(count, 0);
+        starts_.assign(count, 0);
+        ends_.assign(count, 0);
+        desired_.assign(count, 0);
+        
+        active_.clear();
+        for(std::size_t i = 0; i < count; ++i) {
+            active_.push_back(i);
+        }
+        forces(particles, active_, jerks_);
+        
+        for(std::size_t i = 0; i < count; ++i) {
+            W a = vec3<W>(particles.acceleration(i)).magnitude();
+            W j = vec3<W>{jerks_.x[i], jerks_.y[i], jerks_.z[i]}.magnitude();
+            desired_[i] = j > 0 ? T(W(ETA_START) * a / j) : T(0);
+        }
+    }
+    
+    template <typename T>
+    T Hermite<T>::correct(Particles<T>& particles, std::size_t i, T h) {
+        typedef Scalar::Wide<T> W;
+        const W dt = h;
+        vec3<W> x0 = particles.position(i);
+        vec3<W> v0 = particles.velocity(i);
+        vec3<W> a0 = particles.acceleration(i);
+        vec3<W> j0{jerks_.x[i], jerks_.y[i], jerks_.z[i]};
+        vec3<W> a1 = predicted_.acceleration(i);
+        vec3<W> j1{next_.x[i], next_.y[i], next_.z[i]};
+        
+        vec3<W> v1 = v0 + (dt / 2) * (a0 + a1) + (dt * dt / 12) * (j0 - j1);
+        vec3<W> x1 = x0 + (dt / 2) * (v0 + v1) + (dt * dt / 12) * (a0 - a1);
+        
+        // Second and third derivatives of the acceleration at the end of
+        // the step, from the Hermite interpolant.
+        vec3<W> a3 = (12 / (dt * dt * dt)) * (a0 - a1) + (6 / (dt * dt)) * (j0 + j1);
+        vec3<W> a2 = (-6 / (dt * dt)) * (a0 - a1) - (1 / dt) * (4 * j0 + 2 * j1) + dt * a3;
+        
+        particles.setPosition(i, x1);
+        particles.setVelocity(i, v1);
+        particles.setAcceleration(i, a1);
+        jerks_.x[i] = j1.x;
+        jerks_.y[i] = j1.y;
+        jerks_.z[i] = j1.z;
+        
+        W a = a1.magnitude(), j = j1.magnitude();
+        W s = a2.magnitude(), c = a3.magnitude();
+        W below = j * c + s * s;
+        if(below <= 0) { return 0; }
+        return T(std::sqrt(W(ETA) * (a * s + j * j) / below));
+    }
+    
+    template <typename T>
+    T Hermite<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        typedef Scalar::Wide<T> W;
+        const auto count = particles.size();
+        auto span = [&](std::size_t i) { return T(dt / (1u << levels_[i])); };
+        
+        // Every body starts its step together. Shared steps all take the
+        // finest level any body needs.
+        int finest = 0;
+        for(std::size_t i = 0; i < count; ++i) {
+            levels_[i] = level(desired_[i], dt, 0);
+            finest = std::max(finest, levels_[i]);
+        }
+        for(std::size_t i = 0; i < count; ++i) {
+            if(shared_) { levels_[i] = finest; }
+            starts_[i] = 0;
+            ends_[i] = TICKS >> levels_[i];
+        }
+        
+        uint32_t now = 0;
+        while(now < TICKS) {
+            now = *std::min_element(ends_.begin(), ends_.end());
+            
+            // Every body is predicted to now, to pull on the active ones.
+            active_.clear();
+            for(std::size_t i = 0; i < count; ++i) {
+                W h = W(dt) * (now - starts_[i]) / TICKS;
+                vec3<W> a = particles.acceleration(i);
+                vec3<W> j{jerks_.x[i], jerks_.y[i], jerks_.z[i]};
+                predicted_.setPosition(i, vec3<W>(particles.position(i)) + h * vec3<W>(particles.velocity(i))
+                                          + (h * h / 2) * a + (h * h * h / 6) * j);
+                predicted_.setVelocity(i, vec3<W>(particles.velocity(i)) + h * a + (h * h / 2) * j);
+                if(ends_[i] == now) { active_.push_back(i); }
+            }
+            forces(predicted_, active_, next_);
+            
+            finest = 0;
+            for(auto i : active_) {
+                desired_[i] = correct(particles, i, span(i));
+                starts_[i] = now;
+                levels_[i] = level(desired_[i], dt, now);
+                finest = std::max(finest, levels_[i]);
+            }
+            for(auto i : active_) {
+                if(shared_) { levels_[i] = finest; }
+                ends_[i] = now + (TICKS >> levels_[i]);
+            }
+        }
+        return dt;
+    }
+    
+#define INSTANTIATE(T) template class Hermite<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
@@ -0,0 +1,53 @@
+//
+// exo
+// Hermite.hpp - Fourth-order Hermite predictor-corrector scheme.
+//
+// The workhorse of collisional N-body codes (Makino & Aarseth 1992). Bodies
+// are predicted to the end of their step from their acceleration and jerk,
+// new accelerations and jerks are computed there, and the step is corrected
+// with the Hermite interpolant through both ends. One force pass per step
+// gives fourth order accuracy; the jerk costs a few more flops per pair.
+//
+// Each body's step follows Aarseth's criterion, from the derivatives of its
+// acceleration up to the third. With shared steps every body takes the
+// shortest of them; otherwise each body has its own power-of-two fraction
+// of dt, as in BlockVerlet, and only the bodies whose step ends get new
+// forces, from every other body predicted to that time. Either way dt is
+// the longest step, and accelerations on return are those at the predicted
+// positions of the last step.
+//
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Scheme.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class Hermite : public Scheme<T> {
+    public:
+        
+        explicit Hermite(bool shared) : shared_(shared) {}
+        
+        void start(Particles<T>& particles, const Forces<T>& forces) override;
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+    private:
+        
+        // Corrects body i over its step of length h, from the acceleration
+        // and jerk found at its predicted position, and returns the length
+        // of its next step.
+        T correct(Particles<T>& particles, std::size_t i, T h);
+        
+        bool                    shared_;
+        Particles<T>            predicted_;
+        Jerks<T>                jerks_;     // at the start of each body's step
+        Jerks<T>                next_;      // at the predicted positions
+        std::vector<T>          desired_;   // length each body's step should be
+        std::vector<int>        levels_;
+        std::vector<uint32_t>   starts_;    // tick each body's step started at
+        std::vector<uint32_t>   ends_;
+        std::vector<uint32_t>   active_;
+    };
+}
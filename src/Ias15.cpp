@@ -0,0 +1,255 @@
+//
+// exo
+// Ias15.cpp - Adaptive 15th-order Gauss-Radau scheme.
+//
+#include <algorithm>
+#include <cmath>
+#include "Ias15.hpp"
+#include "Math/Compensated.hpp"
+
+namespace Integrator {
+    
+    // Gauss-Radau spacings of the substeps, as fractions of the step.
+    static const long double H[8] = {
+        0.0L,
+        0.0562625605369221464656521910318L,
+        0.180240691736892364987579942780L,
+        0.352624717113169637373907769648L,
+        0.547153626330555383001448554766L,
+        0.734210177215410531523210605558L,
+        0.885320946839095768090359771030L,
+        0.977520613561287501891174488626L
+    };
+    
+    // Relative size of the last term of the fit that steps are sized for.
+    // Smaller than this, the error of a step is below the rounding error.
+    static const double EPSILON = 1e-9;
+    
+    // The divided differences amplify the rounding error of the accelerations
+    // into the last term of the fit by about this many times the machine
+    // epsilon. In float that is far above EPSILON, and steps sized for less
+    // would shrink to nothing chasing rounding noise.
+    static const double NOISE = 4096;
+    
+    // A step whose error calls for one this much shorter is started over,
+    // and steps never grow by more than its inverse at once.
+    static const double SAFETY = 0.25;
+    
+    static const int MAX_ITERATIONS = 12;
+    
+    // NEWTON.c[k][m] is the coefficient of h^(m+1) in h (h - H[1]) ... (h - H[k]),
+    // so that b[m] is the sum of c[k][m] g[k] over k >= m.
+    static const struct Newton {
+        long double c[7][7] = {};
+        
+        Newton() {
+            long double p[8] = {0, 1};
+            for(int k = 0; k < 7; ++k) {
+                if(k > 0) {
+                    for(int m = k + 1; m > 0; --m) {
+                        p[m] = p[m - 1] - H[k] * p[m];
+                    }
+                    p[0] = -H[k] * p[0];
+                }
+                for(int m = 0; m <= k; ++m) {
+                    c[k][m] = p[m + 1];
+                }
+            }
+        }
+    } NEWTON;
+    
+    static long double choose(int n, int k) {
+        long double result = 1;
+        for(int i = 1; i <= k; ++i) {
+            result = result * (n - k + i) / i;
+        }
+        return result;
+    }
+    
+    template <typename T>
+    void Ias15<T>::start(Particles<T>& particles, const Forces<T>& forces) {
+        const auto n = 3 * particles.size();
+        a0_.assign(n, 0);
+        for(auto& b : b_) { b.assign(n, 0); }
+        for(auto& g : g_) { g.assign(n, 0); }
+        
+        stage_ = particles;
+        resetCarry(carry_, particles.size());
+        next_ = 0;
+    }
+    
+    template <typename T>
+    void Ias15<T>::predict(W q, bool restart) {
+        const auto n = a0_.size();
+        
+        W power = 1;
+        for(int k = 0; k < 7; ++k) {
+            power *= q;
+            if(restart) {
+                for(std::size_t i = 0; i < n; ++i) {
+                    b_[k][i] *= power;
+                }
+                continue;
+            }
+            
+            // Moved to start where the step ended, the coefficient of t^(k+1)
+            // gathers that term of every (1 + q t)^(j+1) with j >= k.
+            W weight[7];
+            for(int j = k; j < 7; ++j) {
+                weight[j] = power * choose(j + 1, k + 1);
+            }
+            for(std::size_t i = 0; i < n; ++i) {
+                W sum = 0;
+                for(int j = k; j < 7; ++j) {
+                    sum += weight[j] * b_[j][i];
+                }
+                b_[k][i] = sum;
+            }
+        }
+    }
+    
+    template <typename T>
+    typename Ias15<T>::W Ias15<T>::fit(const Particles<T>& particles, const Forces<T>& forces, W h) {
+        const auto& C = NEWTON.c;
+        const auto count = particles.size();
+        const std::vector<T>* position[3] = {&particles.x, &particles.y, &particles.z};
+        const std::vector<T>* velocity[3] = {&particles.vx, &particles.vy, &particles.vz};
+        const std::vector<T>* carry[3] = {&carry_.x, &carry_.y, &carry_.z};
+        std::vector<T>* stage[3] = {&stage_.x, &stage_.y, &stage_.z};
+        const std::vector<T>* acceleration[3] = {&stage_.ax, &stage_.ay, &stage_.az};
+        
+        W scale = 0;
+        for(auto a : a0_) {
+            scale = std::max(scale, std::abs(a));
+        }
+        if(scale == 0) { return 0; }
+        
+        // Divided differences of the predicted fit.
+        for(int k = 6; k >= 0; --k) {
+            for(std::size_t i = 0; i < a0_.size(); ++i) {
+                W g = b_[k][i];
+                for(int j = k + 1; j < 7; ++j) {
+                    g -= W(C[j][k]) * g_[j][i];
+                }
+                g_[k][i] = g;
+            }
+        }
+        
+        W previous = 0;
+        for(int iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+            W correction = 0;
+            
+            for(int s = 1; s < 8; ++s) {
+                const W t = H[s];
+                for(std::size_t body = 0; body < count; ++body) {
+                    for(int c = 0; c < 3; ++c) {
+                        auto i = 3 * body + c;
+                        W x = W((*position[c])[body]) + (*carry[c])[body];
+                        W sum = b_[6][i] / 72;
+                        for(int k = 5; k >= 0; --k) {
+                            sum = sum * t + b_[k][i] / ((k + 2) * (k + 3));
+                        }
+                        sum = sum * t + a0_[i] / 2;
+                        (*stage[c])[body] = x + t * h * (*velocity[c])[body] + t * t * h * h * sum;
+                    }
+                }
+                
+                forces(stage_);
+                
+                for(std::size_t body = 0; body < count; ++body) {
+                    for(int c = 0; c < 3; ++c) {
+                        auto i = 3 * body + c;
+                        W g = (W((*acceleration[c])[body]) - a0_[i]) / t;
+                        for(int j = 1; j < s; ++j) {
+                            g = (g - g_[j - 1][i]) / (t - H[j]);
+                        }
+                        W delta = g - g_[s - 1][i];
+                        g_[s - 1][i] = g;
+                        for(int m = 0; m < s; ++m) {
+                            b_[m][i] += W(C[s - 1][m]) * delta;
+                        }
+                        if(s == 7) {
+                            correction = std::max(correction, std::abs(delta));
+                        }
+                    }
+                }
+            }
+            
+            // Stop once the corrector has converged, or stalls on rounding
+            // errors.
+            correction /= scale;
+            if(correction < Scalar::epsilon<T>() || (iteration > 1 && correction >= previous)) { break; }
+            previous = correction;
+        }
+        
+        W last = 0;
+        for(auto b : b_[6]) {
+            last = std::max(last, std::abs(b));
+        }
+        return last / scale;
+    }
+    
+    template <typename T>
+    T Ias15<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        const auto count = particles.size();
+        for(std::size_t body = 0; body < count; ++body) {
+            a0_[3 * body + 0] = particles.ax[body];
+            a0_[3 * body + 1] = particles.ay[body];
+            a0_[3 * body + 2] = particles.az[body];
+        }
+        
+        // Steps are sized on their length, h, and go in the direction of dt.
+        // next_ carries the direction of the step it was proposed after.
+        const W sign = dt < 0 ? -1 : 1;
+        const W target = std::max(W(EPSILON), W(NOISE * Scalar::epsilon<T>()));
+        W h = std::abs(W(dt));
+        if(next_ != 0 && std::abs(next_) < h) {
+            h = std::abs(next_);
+            if(sign * next_ < 0) { predict(-1, true); }
+        } else if(next_ != 0) {
+            predict(sign * h / next_, true);
+        }
+        
+        W proposal;
+        for(;;) {
+            W error = fit(particles, forces, sign * h);
+            proposal = error > 0 ? h * std::pow(target / error, W(1) / 7) : h / SAFETY;
+            if(proposal >= SAFETY * h) { break; }
+            
+            // Too long: start over with a shorter step, from the fit just
+            // found rather than from the prediction.
+            predict(proposal / h, true);
+            h = proposal;
+        }
+        
+        const W span = sign * h;
+        std::vector<T>* position[3] = {&particles.x, &particles.y, &particles.z};
+        std::vector<T>* velocity[3] = {&particles.vx, &particles.vy, &particles.vz};
+        std::vector<T>* positionCarry[3] = {&carry_.x, &carry_.y, &carry_.z};
+        std::vector<T>* velocityCarry[3] = {&carry_.vx, &carry_.vy, &carry_.vz};
+        for(std::size_t body = 0; body < count; ++body) {
+            for(int c = 0; c < 3; ++c) {
+                auto i = 3 * body + c;
+                W dx = a0_[i] / 2;
+                W dv = a0_[i];
+                for(int k = 0; k < 7; ++k) {
+                    dx += b_[k][i] / ((k + 2) * (k + 3));
+                    dv += b_[k][i] / (k + 2);
+                }
+                dx = span * (*velocity[c])[body] + span * span * dx;
+                dv = span * dv;
+                compensatedAdd((*position[c])[body], (*positionCarry[c])[body], T(dx));
+                compensatedAdd((*velocity[c])[body], (*velocityCarry[c])[body], T(dv));
+            }
+        }
+        forces(particles);
+        
+        next_ = sign * std::min(proposal, h / SAFETY);
+        predict(next_ / span, false);
+        return T(span);
+    }
+
+#define INSTANTIATE(T) template class Ias15<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
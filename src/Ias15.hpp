@@ -0,0 +1,55 @@
+//
+// exo
+// Ias15.hpp - Adaptive 15th-order Gauss-Radau scheme.
+//
+// Everhart's Radau integrator with the step control of Rein & Spiegel's
+// IAS15. Over each step the accelerations are fitted with a 7th degree
+// polynomial in time, sampled at the Gauss-Radau spacings and refined by
+// predictor-corrector iterations, and positions and velocities are advanced
+// by integrating it. The size of the last term of the fit gives the error of
+// the step, and the next step is sized to keep it below machine precision.
+// Close and eccentric encounters get short steps, quiet stretches long ones.
+//
+// A step never covers more than the time it is asked to, so dt acts as the
+// largest step. It costs 7 force passes per corrector iteration, usually 2,
+// plus one for the accelerations at the end of the step.
+//
+#pragma once
+#include <array>
+#include <vector>
+#include "Scheme.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class Ias15 : public Scheme<T> {
+    public:
+        
+        typedef Scalar::Wide<T> W;
+        
+        void start(Particles<T>& particles, const Forces<T>& forces) override;
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+    private:
+        
+        // Fits the accelerations over a step of size h, and returns the
+        // relative error of the fit.
+        W fit(const Particles<T>& particles, const Forces<T>& forces, W h);
+        
+        // Rescales the fit from a step of size h to one of size q*h, starting
+        // at the same time if restart is set, or where the step ended if not.
+        void predict(W q, bool restart);
+        
+        // Per component, three to a body: accelerations at the start of the
+        // step, and the coefficients of the fit in powers of time (b) and in
+        // Newton's divided differences (g).
+        std::vector<W>                  a0_;
+        std::array<std::vector<W>, 7>   b_;
+        std::array<std::vector<W>, 7>   g_;
+        
+        Particles<T>    stage_;     // bodies at the substeps
+        Particles<T>    carry_;     // rounding errors of positions and velocities
+        W               next_ = 0;  // signed length of the next step, 0 until known
+    };
+}
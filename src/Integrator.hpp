@@ -5,26 +5,45 @@
 // authors:     Amy Parent <amy@amyparent.com>
 //
 #pragma once
-#include <functional>
 #include "Math/vec3.hpp"
+#include "Math/Scalar.hpp"
+#include "Math/Compensated.hpp"
 
 namespace Integrator {
     
     // The state of a simulated body, at a given time.
+    template <typename T>
     struct State {
-        Vector3     position;
-        Vector3     velocity;
-        Vector3     acceleration;
+        vec3<T>     position;
+        vec3<T>     velocity;
+        vec3<T>     acceleration;
     };
     
-    // A function that returns the acceleration vector on a solid body.
-    typedef std::function<Vector3(const State&, long double)> Accelerator;
+    // Applies the body's current acceleration to its velocity for dt.
+    template <typename T>
+    inline void kick(State<T>& state, T dt) {
+        state.velocity += state.acceleration * dt;
+    }
     
-    // Returns the state of a solid body time t+dt, based on the its state
-    // at time t, the forces applied to it and the time increment dt.
-    //
-    // The Accelerator callback will be called during integration to obtain
-    // the acceleration vector for a given state.
-    State advance(const State& state, long double mass, Accelerator callback, double dt);
-
+    // Moves the body along its current velocity for dt.
+    template <typename T>
+    inline void drift(State<T>& state, T dt) {
+        state.position += state.velocity * dt;
+    }
+    
+    // Compensated kick and drift: carry holds the rounding error of previous
+    // updates to the velocity or position, and is fed back into this one.
+    template <typename T>
+    inline void kick(State<T>& state, vec3<T>& carry, T dt) {
+        for(int i = 0; i < 3; ++i) {
+            compensatedAdd(state.velocity[i], carry[i], state.acceleration[i] * dt);
+        }
+    }
+    
+    template <typename T>
+    inline void drift(State<T>& state, vec3<T>& carry, T dt) {
+        for(int i = 0; i < 3; ++i) {
+            compensatedAdd(state.position[i], carry[i], state.velocity[i] * dt);
+        }
+    }
 }
@@ -0,0 +1,50 @@
+//
+// exo
+// Compensated.hpp - Running sums that carry their own rounding error.
+//
+// Adding a small increment to a large total, like a step to a position or to
+// a clock, loses the low bits of the increment every time. A compensated sum
+// keeps what was lost in a second value of the same type and feeds it back
+// into the next addition, so the total stays accurate to about twice the
+// precision of T over any number of steps.
+//
+#pragma once
+
+/*!
+ * @brief       Adds x to sum, carrying the rounding error over in carry.
+ * @details     Uses Knuth's two-sum, so unlike plain Kahan summation it stays
+ *              exact when the increment is larger than the running total.
+ * @tparam      T       The type of the sum.
+ * @param       sum     The running total.
+ * @param       carry   The rounding error left over by previous additions.
+ * @param       x       The value to add.
+ */
+template<typename T>
+inline void
+compensatedAdd(T& sum, T& carry, T x) {
+    T y = x + carry;
+    T s = sum + y;
+    T b = s - sum;
+    carry = (sum - (s - b)) + (y - b);
+    sum = s;
+}
+
+/*!
+ * @brief       A running total and the rounding error it has accumulated.
+ * @tparam      T       The type of the sum.
+ */
+template<typename T>
+struct Compensated {
+    
+    Compensated(T value = 0) : sum(value), carry(0) {}
+    
+    Compensated& operator+=(T x) {
+        compensatedAdd(sum, carry, x);
+        return *this;
+    }
+    
+    T value() const { return sum + carry; }
+    
+    T sum;
+    T carry;
+};
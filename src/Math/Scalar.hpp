@@ -0,0 +1,92 @@
+//
+// exo
+// Scalar.hpp - Floating point types the simulation can be instantiated with.
+//
+// The physics code is templated on its scalar type so that one binary can run
+// float, double, long double and, when built with QUAD=1, __float128
+// simulations. Templates that live in a .cpp file instantiate themselves for
+// every type with EXO_INSTANTIATE_SCALARS.
+//
+#pragma once
+#include <cmath>
+#include <limits>
+#include <ostream>
+
+#ifdef EXO_QUAD
+#include <quadmath.h>
+#define EXO_INSTANTIATE_SCALARS(X) X(float) X(double) X(long double) X(__float128)
+#else
+#define EXO_INSTANTIATE_SCALARS(X) X(float) X(double) X(long double)
+#endif
+
+namespace Scalar {
+    
+    // Type that sums and products liable to overflow or cancel in T are
+    // carried out in: T itself, but never narrower than double. Mass moments
+    // in SI units are well beyond the range of a float.
+    template <typename T>
+    using Wide = decltype(T() * 1.0);
+    
+    // Machine epsilon of T.
+    template <typename T>
+    inline T epsilon() { return std::numeric_limits<T>::epsilon(); }
+#ifdef EXO_QUAD
+    template <>
+    inline __float128 epsilon<__float128>() { return ldexpq(1, -112); }
+#endif
+    
+    // Positive infinity in T. numeric_limits is not specialised for
+    // __float128 in strict C++ modes, and gives 0 for it there.
+    template <typename T>
+    inline T infinity() { return std::numeric_limits<T>::infinity(); }
+#ifdef EXO_QUAD
+    template <>
+    inline __float128 infinity<__float128>() { return __builtin_huge_valq(); }
+#endif
+    
+    // Name of a scalar type, as accepted by the -p option.
+    template <typename T> const char* name();
+    template <> inline const char* name<float>() { return "float"; }
+    template <> inline const char* name<double>() { return "double"; }
+    template <> inline const char* name<long double>() { return "long"; }
+#ifdef EXO_QUAD
+    template <> inline const char* name<__float128>() { return "quad"; }
+#endif
+}
+
+#ifdef EXO_QUAD
+
+// libstdc++ has no <cmath> overloads or stream operators for __float128, so
+// generic code calling std::sqrt and friends is routed to libquadmath here.
+namespace std {
+    inline __float128 sqrt(__float128 x) { return sqrtq(x); }
+    inline __float128 cbrt(__float128 x) { return cbrtq(x); }
+    inline __float128 abs(__float128 x) { return fabsq(x); }
+    inline __float128 fabs(__float128 x) { return fabsq(x); }
+    inline __float128 floor(__float128 x) { return floorq(x); }
+    inline __float128 fmod(__float128 x, __float128 y) { return fmodq(x, y); }
+    inline __float128 exp(__float128 x) { return expq(x); }
+    inline __float128 log(__float128 x) { return logq(x); }
+    inline __float128 pow(__float128 x, __float128 y) { return powq(x, y); }
+    inline __float128 sin(__float128 x) { return sinq(x); }
+    inline __float128 cos(__float128 x) { return cosq(x); }
+    inline __float128 tan(__float128 x) { return tanq(x); }
+    inline __float128 asin(__float128 x) { return asinq(x); }
+    inline __float128 acos(__float128 x) { return acosq(x); }
+    inline __float128 atan(__float128 x) { return atanq(x); }
+    inline __float128 atan2(__float128 y, __float128 x) { return atan2q(y, x); }
+    inline __float128 sinh(__float128 x) { return sinhq(x); }
+    inline __float128 cosh(__float128 x) { return coshq(x); }
+    inline __float128 tanh(__float128 x) { return tanhq(x); }
+    inline __float128 asinh(__float128 x) { return asinhq(x); }
+    inline __float128 acosh(__float128 x) { return acoshq(x); }
+    inline __float128 atanh(__float128 x) { return atanhq(x); }
+    inline bool isfinite(__float128 x) { return finiteq(x); }
+}
+
+// Quad values are printed at long double precision.
+inline std::ostream& operator<<(std::ostream& out, __float128 x) {
+    return out << static_cast<long double>(x);
+}
+
+#endif
@@ -20,10 +20,13 @@
  *              geometric constructs.
  * @tparam      rows            The number of rows in the Matrix.
  * @tparam      cols            The number of columns in the Matrix.
+ * @tparam      T               The type of the Matrix's components.
  */
-template<int rows, int cols>
+template<int rows, int cols, typename T = long double>
 struct matrix {
     
+    typedef T CompType;
+    
     /**
      * @name        Creating Matrices
      * @{
@@ -33,7 +36,7 @@ struct matrix {
      * @brief       Creates a new matrix whose components are initialized to a single value.
      * @param       value       Value to set the matrix's components to.
      */
-    matrix(long double value = 0) {
+    matrix(T value = 0) {
         for(int i = 0; i < rows; ++i) {
             std::fill_n(data[i], cols, value);
         }
@@ -44,12 +47,12 @@ struct matrix {
      * @note        Values should be ordered by column, and then by line.
      * @param       values      Braced list of values to build the matrix from.
      */
-    matrix(std::initializer_list<long double> values) {
+    matrix(std::initializer_list<T> values) {
         if(values.size() != rows*cols) {
             throw std::runtime_error("Wrong number of matrix components");
         }
         int i = 0;
-        for(float v : values) {
+        for(T v : values) {
             data[i/cols][i%cols] = v;
             ++i;
         }
@@ -87,9 +90,9 @@ struct matrix {
      * @brief       Returns the Transpose of the matrix.
      * @return      The transpose of the matrix.
      */
-    matrix<cols, rows>
+    matrix<cols, rows, T>
     transpose() const {
-        matrix<cols, rows> m;
+        matrix<cols, rows, T> m;
         for(int i = 0; i < rows; ++i) {
             for(int j = 0; j < cols; ++j) {
                 m[j][i] = data[i][j];
@@ -98,7 +101,7 @@ struct matrix {
         return m;
     }
     
-    long double
+    T
     determinant() const {
         return 0;
     }
@@ -114,7 +117,7 @@ struct matrix {
      * @return      Pointer to the row's first index. Will be invalidated if the matrix is
      *              deleted from memory.
      */
-    long double*
+    T*
     operator[] (int row) {
         return data[row];
     }
@@ -126,7 +129,7 @@ struct matrix {
      * @return      Pointer to the row's first index. Will be invalidated if the matrix is
      *              deleted from memory.
      */
-    const long double* const
+    const T* const
     operator[] (int row) const {
         return data[row];
     }
@@ -145,7 +148,7 @@ struct matrix {
         return s;
     }
     
-    long double       data[rows][cols];
+    T       data[rows][cols];
     
 };
 
@@ -159,8 +162,8 @@ struct matrix {
  * @internal
  * @brief       Add a matrix to <code>this</code>
  */
-template<int r, int c> matrix<r,c>&
-operator+=(matrix<r,c>& lhs, const matrix<r,c>& rhs) {
+template<int r, int c, typename T> matrix<r,c,T>&
+operator+=(matrix<r,c,T>& lhs, const matrix<r,c,T>& rhs) {
     for(int i = 0; i < r; ++i) {
         for(int j = 0; j < c; ++j) {
             lhs.data[i][j] += rhs.data[i][j];
@@ -173,8 +176,8 @@ operator+=(matrix<r,c>& lhs, const matrix<r,c>& rhs) {
  * @internal
  * @brief       Subtract a matrix from <code>this</code>
  */
-template<int r, int c> matrix<r,c>&
-operator-=(matrix<r,c>& lhs, const matrix<r,c>& rhs) {
+template<int r, int c, typename T> matrix<r,c,T>&
+operator-=(matrix<r,c,T>& lhs, const matrix<r,c,T>& rhs) {
     for(int i = 0; i < r; ++i) {
         for(int j = 0; j < c; ++j) {
             lhs.data[i][j] -= rhs.data[i][j];
@@ -189,8 +192,8 @@ operator-=(matrix<r,c>& lhs, const matrix<r,c>& rhs) {
  * @internal
  * @brief       Multiply <code>this</code> by a scalar.
  */
-template<int r, int c> matrix<r,c>&
-operator*=(matrix<r,c>& lhs, long double scalar) {
+template<int r, int c, typename T> matrix<r,c,T>&
+operator*=(matrix<r,c,T>& lhs, typename matrix<r,c,T>::CompType scalar) {
     for(int i = 0; i < r; ++i) {
         for(int j = 0; j < c; ++j) {
             lhs.data[i][j] *= scalar;
@@ -203,8 +206,8 @@ operator*=(matrix<r,c>& lhs, long double scalar) {
  * @internal
  * @brief       Divide <code>this</code> by a scalar.
  */
-template<int r, int c> matrix<r,c>&
-operator/=(matrix<r,c>& lhs, long double scalar) {
+template<int r, int c, typename T> matrix<r,c,T>&
+operator/=(matrix<r,c,T>& lhs, typename matrix<r,c,T>::CompType scalar) {
     for(int i = 0; i < r; ++i) {
         for(int j = 0; j < c; ++j) {
             lhs.data[i][j] /= scalar;
@@ -222,18 +225,18 @@ operator/=(matrix<r,c>& lhs, long double scalar) {
  * @internal
  * @brief       Add two matrices together.
  */
-template<int r, int c> const matrix<r,c>
-operator+(const matrix<r,c>& lhs, const matrix<r,c>& rhs) {
-    matrix<r,c> m(lhs);
+template<int r, int c, typename T> const matrix<r,c,T>
+operator+(const matrix<r,c,T>& lhs, const matrix<r,c,T>& rhs) {
+    matrix<r,c,T> m(lhs);
     return m += rhs;
 }
 
 /*!
  * @brief       Subtract a matrix from another.
  */
-template<int r, int c> const matrix<r,c>
-operator-(const matrix<r,c>& lhs, const matrix<r,c>& rhs) {
-    matrix<r,c> m(lhs);
+template<int r, int c, typename T> const matrix<r,c,T>
+operator-(const matrix<r,c,T>& lhs, const matrix<r,c,T>& rhs) {
+    matrix<r,c,T> m(lhs);
     return m -= rhs;
 }
 
@@ -241,11 +244,11 @@ operator-(const matrix<r,c>& lhs, const matrix<r,c>& rhs) {
  * @internal
  * @brief       Multiply a matrix by another.
  */
-template<int a, int b, int c> const matrix<a, c>
-operator*(const matrix<a,b>& lhs, const matrix<b,c>& rhs) {
+template<int a, int b, int c, typename T> const matrix<a,c,T>
+operator*(const matrix<a,b,T>& lhs, const matrix<b,c,T>& rhs) {
     //auto _rhs = rhs.transpose();
-    matrix<a,c> p = 0;
-    long double temp;
+    matrix<a,c,T> p = 0;
+    T temp;
     for(int i = 0; i < a; ++i) {
         for(int j = 0; j < c; ++j) {
             temp = 0;
@@ -266,9 +269,9 @@ operator*(const matrix<a,b>& lhs, const matrix<b,c>& rhs) {
  * @internal
  * @brief       Multiply a matrix by a scalar.
  */
-template<int r, int c> const matrix<r,c>
-operator*(const matrix<r,c>& lhs, long double rhs) {
-    matrix<r,c> m(lhs);
+template<int r, int c, typename T> const matrix<r,c,T>
+operator*(const matrix<r,c,T>& lhs, typename matrix<r,c,T>::CompType rhs) {
+    matrix<r,c,T> m(lhs);
     return m *= rhs;
 }
 
@@ -276,18 +279,18 @@ operator*(const matrix<r,c>& lhs, long double rhs) {
  * @internal
  * @brief       Multiply a matrix by a scalar.
  */
-template<int r, int c> const matrix<r,c>
-operator*(long double lhs, const matrix<r,c>& rhs) {
-    matrix<r,c> m(rhs);
+template<int r, int c, typename T> const matrix<r,c,T>
+operator*(typename matrix<r,c,T>::CompType lhs, const matrix<r,c,T>& rhs) {
+    matrix<r,c,T> m(rhs);
     return m *= lhs;
 }
 
 /*!
  * @brief       Divide a matrix by a scalar.
  */
-template<int r, int c> const matrix<r,c>
-operator/(const matrix<r,c>& lhs, long double rhs) {
-    matrix<r,c> m(lhs);
+template<int r, int c, typename T> const matrix<r,c,T>
+operator/(const matrix<r,c,T>& lhs, typename matrix<r,c,T>::CompType rhs) {
+    matrix<r,c,T> m(lhs);
     return m /= rhs;
 }
 
@@ -12,6 +12,7 @@
 #include <cstddef>
 #include <cmath>
 #include "matrix.hpp"
+#include "Scalar.hpp"
 
 
 /**
@@ -59,7 +60,7 @@ struct vec3 final {
      * Casts the vector to another 2D vector type.
      */
     template <typename T2>
-    operator vec3<T2>() {
+    operator vec3<T2>() const {
         return vec3<T2>{static_cast<T2>(x), static_cast<T2>(y), static_cast<T2>(z)};
     }
     
@@ -95,7 +96,7 @@ struct vec3 final {
      * Returns the vector, with a magnitude of 1.
      * @return The vector, with a magnitude of 1.
      */
-    vec3 normalized(double length = 1.0) const {
+    vec3 normalized(T length = 1) const {
         return length * (vec3(*this) / magnitude());
     }
     
@@ -157,13 +158,13 @@ struct vec3 final {
     /*!
      * Rodriges rotation formula
      */
-    vec3 rotate(const vec3& axis, double angle) const {
+    vec3 rotate(const vec3& axis, T angle) const {
         auto p = normalized();
         auto a = axis.normalized();
         auto s = std::sin(angle);
         auto c = std::cos(angle);
         
-        auto t = Mat33{
+        auto t = matrix<3,3,T>{
             a.x*a.x*(1-c) + c,      a.x*a.y*(1-c) - a.z*s,  a.x*a.z*(1-c) + a.y*s,
             a.y*a.x*(1-c) + a.z*s,  a.y*a.y*(1-c) + c,      a.y*a.z*(1-c) - a.x*s,
             a.z*a.x*(1-c) - a.y*s,  a.z*a.y*(1-c) + a.x*s,  a.z*a.z*(1-c) + c,
@@ -288,7 +289,7 @@ vec3<T>& operator/=(vec3<T>& lhs, const vec3<T>& rhs) {
  * @return A reference to the first vector.
  */
 template <typename T>
-vec3<T>& operator/=(vec3<T>& lhs, float rhs) {
+vec3<T>& operator/=(vec3<T>& lhs, typename vec3<T>::CompType rhs) {
     lhs.x /= rhs;
     lhs.y /= rhs;
     lhs.z /= rhs;
@@ -316,7 +317,7 @@ vec3<T>& operator*=(vec3<T>& lhs, const vec3<T>& rhs) {
  * @return A reference to the first vector.
  */
 template <typename T>
-vec3<T>& operator*=(vec3<T>& lhs, float rhs) {
+vec3<T>& operator*=(vec3<T>& lhs, typename vec3<T>::CompType rhs) {
     lhs.x *= rhs;
     lhs.y *= rhs;
     lhs.z *= rhs;
@@ -378,7 +379,7 @@ const vec3<T> operator/(const vec3<T>& lhs, const vec3<T>& rhs) {
  * @return The result of the division.
  */
 template <typename T>
-const vec3<T> operator/(const vec3<T>& lhs, float rhs) {
+const vec3<T> operator/(const vec3<T>& lhs, typename vec3<T>::CompType rhs) {
     vec3<T> result{lhs};
     return result /= rhs;
 }
@@ -402,7 +403,7 @@ const vec3<T> operator*(const vec3<T>& lhs, const vec3<T>& rhs) {
  * @return The result of the product.
  */
 template <typename T>
-const vec3<T> operator*(const vec3<T>& lhs, float rhs) {
+const vec3<T> operator*(const vec3<T>& lhs, typename vec3<T>::CompType rhs) {
     vec3<T> result{lhs};
     return result *= rhs;
 }
@@ -414,7 +415,7 @@ const vec3<T> operator*(const vec3<T>& lhs, float rhs) {
  * @return The result of the product.
  */
 template <typename T>
-const vec3<T> operator*(float lhs, const vec3<T>& rhs) {
+const vec3<T> operator*(typename vec3<T>::CompType lhs, const vec3<T>& rhs) {
     vec3<T> result{rhs};
     return result *= lhs;
 }
@@ -423,8 +424,8 @@ const vec3<T> operator*(float lhs, const vec3<T>& rhs) {
  * @internal
  * @brief       Multiply a vector by a matrix.
  */
-template<typename T, int r>
-const vec3<T> operator*(const matrix<r,3>& lhs, const vec3<T>& rhs) {
+template<typename T, int r, typename U>
+const vec3<T> operator*(const matrix<r,3,U>& lhs, const vec3<T>& rhs) {
     vec3<T> v = vec3<T>{0, 0, 0};
     T temp;
     for(int i = 0; i < 3; ++i) {
@@ -0,0 +1,92 @@
+//
+// exo
+// Octree.cpp - Adaptive octree over a set of bodies.
+//
+#include <algorithm>
+#include "Octree.hpp"
+
+static const int MAX_DEPTH = 32;
+
+template <typename T>
+void Octree<T>::build(const Particles<T>& particles) {
+    const uint32_t count = particles.size();
+    cells_.clear();
+    if(count == 0) { return; }
+    
+    // Bounding cube of the whole system, slightly padded so that no body sits
+    // exactly on its faces.
+    auto xs = std::minmax_element(particles.x.begin(), particles.x.end());
+    auto ys = std::minmax_element(particles.y.begin(), particles.y.end());
+    auto zs = std::minmax_element(particles.z.begin(), particles.z.end());
+    T half = 0.5 * std::max({*xs.second - *xs.first,
+                             *ys.second - *ys.first,
+                             *zs.second - *zs.first});
+    half = half * 1.001 + 1.0;
+    
+    order_.resize(count);
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    mass.resize(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        order_[i] = i;
+    }
+    
+    build(particles, 0, count,
+          0.5 * (*xs.first + *xs.second),
+          0.5 * (*ys.first + *ys.second),
+          0.5 * (*zs.first + *zs.second),
+          half, 0);
+}
+
+template <typename T>
+void Octree<T>::build(const Particles<T>& particles, uint32_t begin, uint32_t end,
+                      T cx, T cy, T cz, T half, int depth) {
+    
+    uint32_t index = cells_.size();
+    cells_.push_back(Cell{cx, cy, cz, half, begin, end, 0, false});
+    
+    if(end - begin <= leafSize_ || depth == MAX_DEPTH) {
+        for(uint32_t k = begin; k < end; ++k) {
+            auto i = order_[k];
+            x[k] = particles.x[i];
+            y[k] = particles.y[i];
+            z[k] = particles.z[i];
+            mass[k] = particles.mass[i];
+        }
+        cells_[index].leaf = true;
+        cells_[index].next = cells_.size();
+        return;
+    }
+    
+    // Split the bodies into octants, x first, then y, then z.
+    auto* first = order_.data();
+    auto below = [](const std::vector<T>& axis, T split) {
+        return [&axis, split](uint32_t i) { return axis[i] < split; };
+    };
+    
+    uint32_t bounds[9];
+    bounds[0] = begin;
+    bounds[8] = end;
+    bounds[4] = std::partition(first + bounds[0], first + bounds[8], below(particles.x, cx)) - first;
+    for(int i = 0; i < 8; i += 4) {
+        bounds[i+2] = std::partition(first + bounds[i], first + bounds[i+4], below(particles.y, cy)) - first;
+    }
+    for(int i = 0; i < 8; i += 2) {
+        bounds[i+1] = std::partition(first + bounds[i], first + bounds[i+2], below(particles.z, cz)) - first;
+    }
+    
+    T quarter = 0.5 * half;
+    for(int octant = 0; octant < 8; ++octant) {
+        if(bounds[octant] == bounds[octant+1]) { continue; }
+        build(particles, bounds[octant], bounds[octant+1],
+              cx + ((octant & 4) ? quarter : -quarter),
+              cy + ((octant & 2) ? quarter : -quarter),
+              cz + ((octant & 1) ? quarter : -quarter),
+              quarter, depth + 1);
+    }
+    cells_[index].next = cells_.size();
+}
+
+#define INSTANTIATE(T) template class Octree<T>;
+EXO_INSTANTIATE_SCALARS(INSTANTIATE)
@@ -0,0 +1,46 @@
+//
+// exo
+// Octree.hpp - Adaptive octree over a set of bodies, shared by the tree solvers.
+//
+// Cells are stored depth-first: the children of a cell follow it directly,
+// and next skips over its whole subtree. Walking forward visits parents before
+// children, walking backward visits children first, and neither needs a stack.
+//
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Particles.hpp"
+
+template <typename T>
+class Octree {
+public:
+    
+    struct Cell {
+        T           x, y, z, half;      // centre and half-width of the cube
+        uint32_t    begin, end;         // range of bodies in tree order
+        uint32_t    next;
+        bool        leaf;
+    };
+    
+    explicit Octree(uint32_t leafSize) : leafSize_(leafSize) {}
+    
+    // Rebuilds the tree around the current positions of the bodies.
+    void build(const Particles<T>& particles);
+    
+    const std::vector<Cell>& cells() const { return cells_; }
+    
+    // Index into the Particles set of the body at a given tree position.
+    const std::vector<uint32_t>& order() const { return order_; }
+    
+    // Positions and masses of the bodies, in tree order.
+    std::vector<T>              x, y, z, mass;
+    
+private:
+    
+    void build(const Particles<T>& particles, uint32_t begin, uint32_t end,
+               T x, T y, T z, T half, int depth);
+    
+    uint32_t                    leafSize_;
+    std::vector<Cell>           cells_;
+    std::vector<uint32_t>       order_;
+};
@@ -6,6 +6,8 @@
 //  Copyright © 2017 Amy Parent. All rights reserved.
 //
 #pragma once
+#include <algorithm>
+#include <cstddef>
 #include <utility>
 #include "Physics.hpp"
 #include "Math/Utils.hpp"
@@ -13,26 +15,88 @@
 
 class Orbit {
     
+    static const int KEPLER_ITERATIONS = 64;
+    
+    // Halley's method on an increasing function, whose root is in [lo, hi].
+    // eval gives the function and its first two derivatives at x. Steps that
+    // fall outside the bracket, which shrinks as the signs come in, bisect it
+    // instead, so the iterations converge from any guess.
+    template <typename T, typename Eval>
+    static T halley(T lo, T hi, T x, Eval eval) {
+        const T epsilon = 4 * Scalar::epsilon<T>();
+        x = std::min(std::max(x, lo), hi);
+        for(int i = 0; i < KEPLER_ITERATIONS; ++i) {
+            T f, df, ddf;
+            eval(x, f, df, ddf);
+            if(f == 0) { break; }
+            if(f < 0) { lo = x; } else { hi = x; }
+            
+            T delta = f / (df - f * ddf / (2 * df));
+            if(std::abs(delta) <= epsilon * std::max(T(1), std::abs(x))) {
+                x -= delta;
+                break;
+            }
+            T next = x - delta;
+            if(!(next > lo && next < hi)) { next = lo + (hi - lo) / 2; }
+            if(next == x) { break; }
+            x = next;
+        }
+        return x;
+    }
+    
+    // x - sin(x), or sinh(x) - x if hyperbolic is set. Near 0, where both
+    // eccentric and hyperbolic anomalies of nearly parabolic orbits spend
+    // their pericentre passage, the subtraction would leave noise, so the
+    // series is summed instead.
+    template <typename T>
+    static T tail(T x, bool hyperbolic) {
+        if(std::abs(x) >= 1) { return hyperbolic ? std::sinh(x) - x : x - std::sin(x); }
+        T x2 = x * x;
+        T term = x * x2 / 6;
+        T sum = 0;
+        for(int k = 2; term != 0 && std::abs(term) > Scalar::epsilon<T>() * std::abs(sum); k += 2) {
+            sum += term;
+            term *= (hyperbolic ? x2 : -x2) / ((k + 2) * (k + 3));
+        }
+        return sum;
+    }
+    
+    // Markley's (1995) cubic starter for the eccentric anomaly, for M in
+    // [0, pi], and his fifth-order correction of it.
+    template <typename T>
+    static T markley(T M, T e) {
+        const T pi = std::acos(T(-1));
+        T alpha = (3 * pi * pi + T(1.6) * pi * (pi - M) / (1 + e)) / (pi * pi - 6);
+        T d = 3 * (1 - e) + alpha * e;
+        T q = 2 * alpha * d * (1 - e) - M * M;
+        T r = 3 * alpha * d * (d - 1 + e) * M + M * M * M;
+        T w = std::cbrt(std::abs(r) + std::sqrt(std::max(T(0), q * q * q + r * r)));
+        w *= w;
+        T E = (2 * r * w / (w * w + w * q + q * q) + M) / d;
+        if(!std::isfinite(E)) { return M; }
+        
+        T f2 = e * std::sin(E);
+        T f3 = e * std::cos(E);
+        T f0 = E - f2 - M;
+        T f1 = 1 - f3;
+        T d3 = -f0 / (f1 - f0 * f2 / (2 * f1));
+        T d4 = -f0 / (f1 + d3 * f2 / 2 + d3 * d3 * f3 / 6);
+        T d5 = -f0 / (f1 + d4 * f2 / 2 + d4 * d4 * f3 / 6 - d4 * d4 * d4 * f2 / 24);
+        return std::isfinite(d5) ? E + d5 : E;
+    }
+    
     long double a_, e_, i_, arg_, raan_, m_, T_;
     
     Orbit(long double a, long double e, long double i,
           long double arg, long double raan, long double m, long double T)
         : a_(a), e_(e), i_(i), arg_(arg), raan_(raan), m_(m), T_(T) {}
-            
+    
     std::pair<Vector3, Vector3> hyperbolicSV(long double GM, long double t) const {
         
         long double n = std::sqrt(GM/(-a_*-a_*-a_));
         long double M = m_ + n * ((t - T_) * 86400.0);
         
-        long double H = M;
-        long double delta = 1.0;
-        long double epsilon = 1e-10;
-        
-        while(delta > epsilon) {
-            long double newH = H + (M - (e_ * std::sinh(H)) + H)/((e_ * std::cosh(H)) - 1);
-            delta = std::abs(H - newH);
-            H = newH;
-        }
+        long double H = hyperbolicAnomaly(M, e_);
         
         // true anomaly:
         long double v = 2 * std::atan(std::sqrt((e_+1.0)/(e_-1.0)) * std::tanh(H/2.0));
@@ -57,29 +121,224 @@ class Orbit {
         
         return std::make_pair(pos, vel);
     }
-    
+
 public:
     
+    // Solves Kepler's equation M = E - e sin(E) for the eccentric anomaly E of
+    // an elliptic orbit, from the estimate guess. E - M is never more than e,
+    // so the root is bracketed from the start, and Halley steps that would
+    // leave the bracket bisect it instead: a bad guess or an eccentricity
+    // close to 1 costs iterations, but never convergence.
+    template <typename T>
+    static T eccentricAnomaly(T M, T e, T guess) {
+        return halley(M - e, M + e, guess, [M, e](T E, T& f, T& df, T& ddf) {
+            T s = std::sin(E / 2);
+            T c = std::cos(E / 2);
+            ddf = 2 * e * s * c;
+            f = (std::abs(E) < 1 ? (1 - e) * E + e * tail(E, false) : E - ddf) - M;
+            df = (1 - e) + 2 * e * s * s;
+        });
+    }
+    
+    // Same, from Markley's (1995) starter, which is good to a few roundings
+    // in double by itself, so the iterations only confirm it.
+    template <typename T>
+    static T eccentricAnomaly(T M, T e) {
+        const T pi = std::acos(T(-1));
+        T turns = std::floor(M / (2 * pi) + T(0.5));
+        T m = M - turns * 2 * pi;
+        T E0 = m < 0 ? -markley(-m, e) : markley(m, e);
+        return turns * 2 * pi + eccentricAnomaly(m, e, E0);
+    }
+    
+    // Solves M = e sinh(H) - H for the hyperbolic anomaly H of a hyperbolic
+    // orbit, from the estimate guess. H is bracketed by asinh(M / e) on one
+    // side, and by asinh(M / (e - 1)) and cbrt(6 M / e) on the other.
+    template <typename T>
+    static T hyperbolicAnomaly(T M, T e, T guess) {
+        T near = std::asinh(M / e);
+        T far = std::cbrt(6 * M / e);
+        T other = std::asinh(M / (e - 1));
+        if(std::abs(other) < std::abs(far)) { far = other; }
+        return halley(std::min(near, far), std::max(near, far), guess, [M, e](T H, T& f, T& df, T& ddf) {
+            T s = std::sinh(H / 2);
+            f = (e - 1) * H + e * tail(H, true) - M;
+            df = (e - 1) + 2 * e * s * s;
+            ddf = e * std::sinh(H);
+        });
+    }
+    
+    // Same, from the root of the cubic the equation becomes for small H
+    // when that is small, and from asinh(M / e) otherwise.
+    template <typename T>
+    static T hyperbolicAnomaly(T M, T e) {
+        T p = 2 * (e - 1) / e;
+        T q = 3 * std::abs(M) / e;
+        T A = std::cbrt(q + std::sqrt(q * q + p * p * p));
+        T H0 = A - p / A;
+        if(!(H0 < 1)) { H0 = std::asinh(std::abs(M) / e); }
+        return hyperbolicAnomaly(M, e, M < 0 ? -H0 : H0);
+    }
+    
+    // Solves Kepler's equation for count orbits at once, as the single
+    // versions without a guess. Each costs a starter and one or two Halley
+    // steps, with no allocation.
+    template <typename T>
+    static void eccentricAnomalies(const T* M, const T* e, T* E, std::size_t count) {
+        for(std::size_t i = 0; i < count; ++i) {
+            E[i] = eccentricAnomaly(M[i], e[i]);
+        }
+    }
+    
+    template <typename T>
+    static void hyperbolicAnomalies(const T* M, const T* e, T* H, std::size_t count) {
+        for(std::size_t i = 0; i < count; ++i) {
+            H[i] = hyperbolicAnomaly(M[i], e[i]);
+        }
+    }
+    
+    // Stumpff functions c0 to c3 of z: cos(sqrt(z)), sin(sqrt(z)) / sqrt(z),
+    // (1 - cos(sqrt(z))) / z and (sqrt(z) - sin(sqrt(z))) / sqrt(z)^3,
+    // continued to cosh and sinh for negative z. Near zero they are summed
+    // from their series.
+    template <typename T>
+    static void stumpff(T z, T& c0, T& c1, T& c2, T& c3) {
+        if(std::abs(z) < 1) {
+            // Only c2 and c3 are summed: c0 = 1 - z c2 and c1 = 1 - z c3.
+            T c[2] = {0, 0};
+            for(int k = 2; k < 4; ++k) {
+                T term = T(1) / (k == 2 ? 2 : 6);
+                T& sum = c[k - 2];
+                for(int n = 0; term != 0 && std::abs(term) > Scalar::epsilon<T>() * std::abs(sum); ++n) {
+                    sum += term;
+                    term *= -z / ((2 * n + k + 1) * (2 * n + k + 2));
+                }
+            }
+            c2 = c[0];
+            c3 = c[1];
+            c0 = 1 - z * c2;
+            c1 = 1 - z * c3;
+            return;
+        }
+        if(z > 0) {
+            T s = std::sqrt(z);
+            c0 = std::cos(s);
+            c1 = std::sin(s) / s;
+        } else {
+            T s = std::sqrt(-z);
+            c0 = std::cosh(s);
+            c1 = std::sinh(s) / s;
+        }
+        c2 = (1 - c0) / z;
+        c3 = (1 - c1) / z;
+    }
+    
+    // A first guess at the universal anomaly s, with dt = r ds, that a body
+    // covers in dt on its two-body orbit about a centre of gravitational
+    // parameter GM. Over more than about a radian of anomaly, t grows like
+    // cosh(sqrt(-beta) s) on a hyperbola, and steps from dt / r0 would only
+    // creep towards the root, so the guess comes from the Kepler solvers
+    // instead: s is the change of eccentric or hyperbolic anomaly over
+    // sqrt(|beta|), where beta is GM / a. The elements are only a guess here
+    // and may lose digits.
+    template <typename T>
+    static T universalAnomaly(const vec3<T>& position, const vec3<T>& velocity, T GM, T dt) {
+        T r0 = position.magnitude();
+        T eta = vec3<T>::dot(position, velocity);
+        T beta = 2 * GM / r0 - vec3<T>::dot(velocity, velocity);
+        T s = dt / r0;
+        if(!(std::abs(beta) * s * s > 1)) { return s; }
+        
+        T k = std::sqrt(std::abs(beta));
+        T n = std::abs(beta) * k / GM;
+        T ecos = 1 - r0 * beta / GM;
+        T esin = eta * k / GM;
+        if(beta > 0) {
+            T E0 = std::atan2(esin, ecos);
+            T e = std::sqrt(ecos * ecos + esin * esin);
+            s = (eccentricAnomaly(E0 - esin + n * dt, e) - E0) / k;
+        } else {
+            // e from the angular momentum, as ecos and esin cancel far out.
+            T h = vec3<T>::cross(position, velocity).magnitude();
+            T e = std::sqrt(1 - beta * h * h / (GM * GM));
+            T H0 = std::asinh(esin / e);
+            s = (hyperbolicAnomaly(esin - H0 + n * dt, e) - H0) / k;
+        }
+        return std::isfinite(s) ? s : dt / r0;
+    }
+    
+    // Moves a body along its two-body orbit about a centre of gravitational
+    // parameter GM for dt, from its position and velocity relative to the
+    // centre, whatever its eccentricity. This is the universal variable
+    // formulation: in s, with dt = r ds, the same Kepler equation in Stumpff
+    // functions holds for ellipses, parabolas and hyperbolas, so there are no
+    // elements to work out and no branch to pick. Whole periods of a bound
+    // orbit are taken off dt first.
+    template <typename T>
+    static void propagate(vec3<T>& position, vec3<T>& velocity, T GM, T dt) {
+        T r0 = position.magnitude();
+        if(r0 == 0 || GM <= 0 || dt == 0) { return; }
+        T eta = vec3<T>::dot(position, velocity);
+        T beta = 2 * GM / r0 - vec3<T>::dot(velocity, velocity);   // GM / a
+        
+        if(beta > 0) {
+            T period = 2 * std::acos(T(-1)) * GM / (beta * std::sqrt(beta));
+            dt -= period * std::floor(dt / period + T(0.5));
+        }
+        
+        // Halley's method on the Kepler equation t(s) = dt, inside a bracket
+        // that shrinks as it goes and is open on one side until the first
+        // step past dt.
+        T s = universalAnomaly(position, velocity, GM, dt);
+        T low = dt > 0 ? T(0) : -Scalar::infinity<T>();
+        T high = dt > 0 ? Scalar::infinity<T>() : T(0);
+        T c0, c1, c2, c3;
+        for(int i = 0; i < KEPLER_ITERATIONS; ++i) {
+            stumpff(beta * s * s, c0, c1, c2, c3);
+            T f = r0 * s * c1 + eta * s * s * c2 + GM * s * s * s * c3 - dt;
+            T r = r0 * c0 + eta * s * c1 + GM * s * s * c2;
+            T dr = eta * c0 + (GM - beta * r0) * s * c1;
+            if(f == 0) { break; }
+            // An s far past the root on a hyperbola overflows t.
+            ((std::isfinite(f) ? f < 0 : dt < 0) ? low : high) = s;
+            
+            // While the bracket is open, steps at most double s, as one from
+            // where t is still flat can land far enough out to overflow.
+            T next = s - f / (r - f * dr / (2 * r));
+            bool open = !std::isfinite(low) || !std::isfinite(high);
+            if(!(next > low && next < high) || (open && std::abs(next) > 2 * std::abs(s))) {
+                next = open ? 2 * s : low + (high - low) / 2;
+            }
+            T delta = next - s;
+            s = next;
+            if(std::abs(delta) <= 4 * Scalar::epsilon<T>() * std::abs(s)) { break; }
+        }
+        stumpff(beta * s * s, c0, c1, c2, c3);
+        
+        // Lagrange's f and g, with g written so as not to cancel over short
+        // steps.
+        T G1 = s * c1, G2 = s * s * c2;
+        T r = r0 * c0 + eta * G1 + GM * G2;
+        T f = 1 - GM * G2 / r0;
+        T g = r0 * G1 + eta * G2;
+        T fdot = -GM * G1 / (r * r0);
+        T gdot = 1 - GM * G2 / r;
+        
+        vec3<T> next = f * position + g * velocity;
+        velocity = fdot * position + gdot * velocity;
+        position = next;
+    }
+    
     std::pair<Vector3, Vector3> stateVectors(long double GM,
                                              long double t = Physics::J2000) const {
         
-        // eccentric anomaly, using kepler's method
-        // http://www.bogan.ca/orbits/kepler/keplerex.html
         if(e_ > 1.0 || a_ <= 0) { return hyperbolicSV(GM, t); }
         
         long double a = std::abs(a_);
         long double n = std::sqrt(GM/(a*a*a));
         long double Ma = m_ + n * ((t - T_) * 86400.0);
         
-        long double Ea = Ma + e_ * std::sin(Ma);
-        long double delta = 1.0;
-        long double epsilon = 1e-10;
-        
-        while(delta > epsilon) {
-            long double newEa = Ma + e_ * std::sin(Ea);
-            delta = std::abs(Ea - newEa);
-            Ea = newEa;
-        }
+        long double Ea = eccentricAnomaly(Ma, e_);
         
         // true anomaly:
         long double v = 2 * std::atan(std::sqrt((1.0+e_)/(1.0-e_)) * std::tan(Ea/2.0));
@@ -111,7 +370,7 @@ public:
     class Builder {
         
         long double a_, e_, i_, arg_, raan_, m_, T_;
-        
+    
     public:
         
         Builder() : a_(0), e_(0), i_(0), arg_(0), raan_(0), m_(0), T_(Physics::J2000) {}
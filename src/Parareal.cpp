@@ -0,0 +1,129 @@
+//
+// exo
+// Parareal.cpp - Parallel-in-time integration of few-body systems.
+//
+#include <algorithm>
+#include <cmath>
+#include "Parareal.hpp"
+
+namespace Integrator {
+    
+    // Largest relative change of the guesses, against the size of the system
+    // and of its velocities, at which the iterations stop. Types too coarse
+    // for it stop a few roundings above their epsilon instead.
+    static const double TOLERANCE = 1e-12;
+    static const double ROUNDINGS = 64;
+    
+    // Sets guess to fine + coarse - old, position and velocity, and returns
+    // how far it moved.
+    template <typename T>
+    static Scalar::Wide<T> correct(Particles<T>& guess, const Particles<T>& fine,
+                                   const Particles<T>& coarse, const Particles<T>& old) {
+        typedef Scalar::Wide<T> W;
+        W size = 0, speed = 0, moved = 0, sped = 0;
+        for(std::size_t i = 0; i < guess.size(); ++i) {
+            vec3<W> position = vec3<W>(fine.position(i)) + (vec3<W>(coarse.position(i)) - vec3<W>(old.position(i)));
+            vec3<W> velocity = vec3<W>(fine.velocity(i)) + (vec3<W>(coarse.velocity(i)) - vec3<W>(old.velocity(i)));
+            moved = std::max(moved, (position - vec3<W>(guess.position(i))).magnitude());
+            sped = std::max(sped, (velocity - vec3<W>(guess.velocity(i))).magnitude());
+            size = std::max(size, position.magnitude());
+            speed = std::max(speed, velocity.magnitude());
+            guess.setPosition(i, position);
+            guess.setVelocity(i, velocity);
+        }
+        return std::max(size > 0 ? moved / size : moved, speed > 0 ? sped / speed : sped);
+    }
+    
+    template <typename T>
+    Parareal<T>::Parareal(const std::string& fine, const Config& config, unsigned slices)
+    : name_(fine)
+    , config_(config)
+    , slices_(slices)
+    , verlet_(false)
+    , kepler_(false) {
+    }
+    
+    template <typename T>
+    void Parareal<T>::coarse(const Particles<T>& start, Particles<T>& end, const Forces<T>& forces, T dt) {
+        W star = start.mass[0], total = 0;
+        for(auto m : start.mass) { total += m; }
+        Scheme<T>& scheme = 2 * star > total ? static_cast<Scheme<T>&>(kepler_) : verlet_;
+        
+        end = start;
+        scheme.start(end, forces);
+        for(unsigned i = 0; i < COARSE; ++i) {
+            scheme.step(end, forces, dt / T(COARSE));
+        }
+    }
+    
+    template <typename T>
+    void Parareal<T>::fine(const Particles<T>& start, Particles<T>& end, Lane& lane, T dt) {
+        Forces<T> forces{*lane.gravity, *lane.pool};
+        end = start;
+        forces(end);
+        lane.scheme->start(end, forces);
+        
+        // Each step asks for an even share of what is left, so that fixed
+        // steps land on the end of the slice.
+        T covered = 0;
+        for(unsigned i = 0; std::abs(covered) < std::abs(dt); ++i) {
+            covered += lane.scheme->step(end, forces, (dt - covered) / T(i < FINE ? FINE - i : 1));
+        }
+    }
+    
+    template <typename T>
+    T Parareal<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        while(lanes_.size() < forces.pool.size()) {
+            lanes_.push_back(Lane{std::unique_ptr<ThreadPool>(new ThreadPool(1)),
+                                  Gravity<T>::named(config_.solver, config_.gravity),
+                                  Scheme<T>::named(name_, config_)});
+        }
+        
+        const T slice = dt / T(slices_);
+        const W tolerance = std::max(W(TOLERANCE), W(ROUNDINGS * Scalar::epsilon<T>()));
+        
+        guesses_.resize(slices_ + 1);
+        fine_.resize(slices_);
+        coarse_.resize(slices_);
+        
+        guesses_[0] = particles;
+        for(unsigned n = 0; n < slices_; ++n) {
+            coarse(guesses_[n], coarse_[n], forces, slice);
+            guesses_[n + 1] = coarse_[n];
+        }
+        
+        // Slices before the k-th are already exact, and are not run again.
+        Particles<T> next;
+        unsigned k = 0;
+        while(k < slices_) {
+            forces.pool.run(slices_ - k, 1, [&](std::size_t begin, std::size_t end, unsigned thread) {
+                for(auto n = k + begin; n < k + end; ++n) {
+                    fine(guesses_[n], fine_[n], lanes_[thread], slice);
+                }
+            });
+            
+            W change = 0;
+            for(unsigned n = k; n < slices_; ++n) {
+                if(n == k) {
+                    next = coarse_[n];
+                } else {
+                    coarse(guesses_[n], next, forces, slice);
+                }
+                change = std::max(change, correct(guesses_[n + 1], fine_[n], next, coarse_[n]));
+                forces(guesses_[n + 1]);
+                std::swap(coarse_[n], next);
+            }
+            
+            ++k;
+            if(change <= tolerance) { break; }
+        }
+        
+        iterations_ = k;
+        particles = guesses_[slices_];
+        return dt;
+    }
+
+#define INSTANTIATE(T) template class Parareal<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
@@ -0,0 +1,90 @@
+//
+// exo
+// Parareal.hpp - Parallel-in-time integration of few-body systems.
+//
+// A system of a handful of bodies has nothing to split across threads within
+// a step, so Lions, Maday and Turinici's Parareal splits the step itself into
+// slices of time instead. A cheap coarse pass, a few long steps per slice,
+// guesses the state at the start of every slice in turn. Every slice
+// is then integrated from its guess with the fine scheme, all of them at
+// once on separate threads, and the guesses are corrected by how far the
+// fine and coarse results for the slice before them differ:
+//
+//      U[n+1] = F(U[n]) + G(U[n]) - G(U[n] of the last iteration)
+//
+// with G the coarse pass over a slice and F the fine one. Corrections are
+// repeated until the guesses stop moving. The first slice is exact after
+// the first iteration, the first two after the second, and so on, so the
+// result is the fine one after at most as many iterations as there are
+// slices, and usually after far fewer.
+//
+// The coarse pass is the Wisdom-Holman map when body 0 holds most of the
+// mass, as long Verlet steps lose track of the orbits within a slice or two
+// and the iterations then barely converge faster than the slices get exact.
+// Other systems get Verlet.
+//
+// Each thread sums gravity with its own copy of the solver the rest of the
+// run uses, named in the scheme's configuration.
+//
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Scheme.hpp"
+#include "VelocityVerlet.hpp"
+#include "WisdomHolman.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class Parareal : public Scheme<T> {
+    public:
+        
+        typedef Scalar::Wide<T> W;
+        
+        // Steps per slice in the coarse pass, and steps the fine scheme is
+        // asked for per slice. Adaptive fine schemes take them as their
+        // longest.
+        static const unsigned COARSE = 4;
+        static const unsigned FINE = 64;
+        
+        // Splits every step into the given number of slices, each integrated
+        // with the scheme called fine.
+        Parareal(const std::string& fine, const Config& config, unsigned slices);
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+        // Number of iterations the last step took to converge.
+        unsigned iterations() const { return iterations_; }
+        
+    private:
+        
+        // What a thread needs to run the fine scheme on its own.
+        struct Lane {
+            std::unique_ptr<ThreadPool>     pool;
+            std::unique_ptr<Gravity<T>>     gravity;
+            std::unique_ptr<Scheme<T>>      scheme;
+        };
+        
+        // Runs the coarse pass over a slice of dt from start into end.
+        void coarse(const Particles<T>& start, Particles<T>& end, const Forces<T>& forces, T dt);
+        
+        // Runs the fine scheme over a slice of dt from start into end.
+        void fine(const Particles<T>& start, Particles<T>& end, Lane& lane, T dt);
+        
+        std::string                 name_;
+        Config                      config_;
+        unsigned                    slices_;
+        unsigned                    iterations_ = 0;
+        
+        VelocityVerlet<T>           verlet_;
+        WisdomHolman<T>             kepler_;
+        std::vector<Lane>           lanes_;     // one per thread of the pool
+        
+        // Per slice boundary: the guessed state, and per slice: the fine and
+        // coarse passes from the guess at its start.
+        std::vector<Particles<T>>   guesses_;
+        std::vector<Particles<T>>   fine_;
+        std::vector<Particles<T>>   coarse_;
+    };
+}
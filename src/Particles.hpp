@@ -0,0 +1,49 @@
+//
+// exo
+// Particles.hpp - Structure-of-arrays storage for the simulation's hot state.
+//
+// Everything the integrator and the force pass touch on every step lives
+// here, one contiguous array per component. Cold data (names, colors, trails)
+// stays in StarSystem::Body so stepping never drags it through the cache.
+//
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "Math/vec3.hpp"
+#include "Integrator.hpp"
+
+template <typename T>
+struct Particles {
+
+    std::vector<T>  x, y, z;
+    std::vector<T>  vx, vy, vz;
+    std::vector<T>  ax, ay, az;
+    std::vector<T>  mass;
+
+    std::size_t size() const { return mass.size(); }
+
+    void push_back(const Integrator::State<T>& state, T m) {
+        x.push_back(state.position.x);
+        y.push_back(state.position.y);
+        z.push_back(state.position.z);
+        vx.push_back(state.velocity.x);
+        vy.push_back(state.velocity.y);
+        vz.push_back(state.velocity.z);
+        ax.push_back(state.acceleration.x);
+        ay.push_back(state.acceleration.y);
+        az.push_back(state.acceleration.z);
+        mass.push_back(m);
+    }
+
+    vec3<T> position(std::size_t i) const { return vec3<T>{x[i], y[i], z[i]}; }
+    vec3<T> velocity(std::size_t i) const { return vec3<T>{vx[i], vy[i], vz[i]}; }
+    vec3<T> acceleration(std::size_t i) const { return vec3<T>{ax[i], ay[i], az[i]}; }
+
+    void setPosition(std::size_t i, const vec3<T>& p) { x[i] = p.x; y[i] = p.y; z[i] = p.z; }
+    void setVelocity(std::size_t i, const vec3<T>& v) { vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+    void setAcceleration(std::size_t i, const vec3<T>& a) { ax[i] = a.x; ay[i] = a.y; az[i] = a.z; }
+
+    Integrator::State<T> state(std::size_t i) const {
+        return Integrator::State<T>{position(i), velocity(i), acceleration(i)};
+    }
+};
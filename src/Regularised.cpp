@@ -0,0 +1,277 @@
+//
+// exo
+// Regularised.cpp - Kustaanheimo-Stiefel regularisation of close pairs.
+//
+#include <algorithm>
+#include <cmath>
+#include "Regularised.hpp"
+#include "Orbit.hpp"
+#include "Physics.hpp"
+
+namespace Integrator {
+    
+    // A pair is close when its free-fall time, sqrt(r^3 / mu) at the closest
+    // the two get over the step, is less than CLOSE steps...
+    static const double CLOSE = 10;
+    
+    // ...and the rest of the system pulls them apart less than PERTURBATION
+    // times as hard as they pull on each other.
+    static const double PERTURBATION = 1;
+    
+    // Bodies per thread in the search for pairs, each checked against all.
+    static const std::size_t GRAIN = 64;
+    
+    static const int MAX_ITERATIONS = 64;
+    
+    template <typename T>
+    Regularised<T>::Regularised(std::unique_ptr<Scheme<T>> scheme)
+    : scheme_(std::move(scheme)) {
+    }
+    
+    template <typename T>
+    bool Regularised<T>::kepler(vec3<W>& position, vec3<W>& velocity, W mu, W dt) {
+        W r0 = position.magnitude();
+        if(r0 == 0 || mu <= 0) { return true; }
+        
+        // u is a 4-vector whose bilinear square L(u) u is the position, with
+        // |u|^2 = r. Of the circle of such vectors, the one with u3 or u4 zero
+        // is taken, whichever keeps the square root away from cancelling.
+        W u[4];
+        if(position.x >= 0) {
+            u[0] = std::sqrt((r0 + position.x) / 2);
+            u[1] = position.y / (2 * u[0]);
+            u[2] = position.z / (2 * u[0]);
+            u[3] = 0;
+        } else {
+            u[1] = std::sqrt((r0 - position.x) / 2);
+            u[0] = position.y / (2 * u[1]);
+            u[3] = position.z / (2 * u[1]);
+            u[2] = 0;
+        }
+        
+        // With dt = r ds, u' = L(u)^T v / 2, and the two-body problem becomes
+        // u'' = (h / 2) u, where h is the energy per unit reduced mass.
+        const vec3<W>& v = velocity;
+        W p[4] = {
+            (u[0] * v.x + u[1] * v.y + u[2] * v.z) / 2,
+            (-u[1] * v.x + u[0] * v.y + u[3] * v.z) / 2,
+            (-u[2] * v.x - u[3] * v.y + u[0] * v.z) / 2,
+            (u[3] * v.x - u[2] * v.y + u[1] * v.z) / 2
+        };
+        W beta = (mu / r0 - vec3<W>::dot(v, v) / 2) / 2;     // -h / 2
+        W uu = r0, up = 0, pp = 0;
+        for(int k = 0; k < 4; ++k) {
+            up += u[k] * p[k];
+            pp += p[k] * p[k];
+        }
+        
+        // Time is the integral of r = |u|^2 over the fictitious time s, which
+        // is the universal anomaly of Orbit::propagate, so it starts from the
+        // same guess: from dt / r0 the steps would only creep towards the root
+        // on a hyperbola. Whole periods of a bound orbit are taken off dt
+        // first. It is solved by Newton's method inside a bracket that
+        // shrinks as it goes, and is open on one side until the first step
+        // past dt.
+        if(beta > 0) {
+            W period = std::acos(W(-1)) * mu / (4 * beta * std::sqrt(beta));
+            dt -= period * std::floor(dt / period + W(0.5));
+        }
+        if(dt == 0) { return true; }
+        W s = Orbit::universalAnomaly(position, velocity, mu, dt);
+        W low = dt > 0 ? W(0) : -Scalar::infinity<W>();
+        W high = dt > 0 ? Scalar::infinity<W>() : W(0);
+        W c0, c1, c2, c3;
+        bool converged = false;
+        for(int i = 0; i < MAX_ITERATIONS && !converged; ++i) {
+            W d0, d1, d2, d3;
+            Orbit::stumpff(beta * s * s, c0, c1, c2, c3);
+            Orbit::stumpff(4 * beta * s * s, d0, d1, d2, d3);
+            W S = s * c1;
+            W t = uu * s * (1 + d1) / 2 + up * S * S + 2 * pp * s * s * s * d3;
+            W r = c0 * c0 * uu + 2 * c0 * S * up + S * S * pp;
+            if(t == dt) { converged = true; break; }
+            // An s far past the root on a hyperbola overflows t.
+            ((std::isfinite(t) ? t < dt : dt < 0) ? low : high) = s;
+            
+            // While the bracket is open, steps at most double s, as one from
+            // where t is still flat can land far enough out to overflow.
+            W next = s - (t - dt) / r;
+            bool open = !std::isfinite(low) || !std::isfinite(high);
+            if(!(next > low && next < high) || (open && std::abs(next) > 2 * std::abs(s))) {
+                next = open ? 2 * s : low + (high - low) / 2;
+            }
+            W delta = next - s;
+            s = next;
+            converged = std::abs(delta) <= 4 * Scalar::epsilon<W>() * std::abs(s);
+        }
+        if(!converged || !std::isfinite(s)) { return false; }
+        Orbit::stumpff(beta * s * s, c0, c1, c2, c3);
+        
+        W q[4], dq[4];
+        for(int k = 0; k < 4; ++k) {
+            q[k] = c0 * u[k] + s * c1 * p[k];
+            dq[k] = -beta * s * c1 * u[k] + c0 * p[k];
+        }
+        W r = q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+        position = vec3<W>{
+            q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3],
+            2 * (q[0] * q[1] - q[2] * q[3]),
+            2 * (q[0] * q[2] + q[1] * q[3])
+        };
+        velocity = (2 / r) * vec3<W>{
+            q[0] * dq[0] - q[1] * dq[1] - q[2] * dq[2] + q[3] * dq[3],
+            q[1] * dq[0] + q[0] * dq[1] - q[3] * dq[2] - q[2] * dq[3],
+            q[2] * dq[0] + q[3] * dq[1] + q[0] * dq[2] + q[1] * dq[3]
+        };
+        return true;
+    }
+    
+    template <typename T>
+    void Regularised<T>::pair(const Particles<T>& particles, T dt, ThreadPool& pool) {
+        const auto count = particles.size();
+        const W G = Physics::G;
+        const W span = std::abs(W(dt));
+        const W limit = W(CLOSE) * W(CLOSE) * span * span;
+        const W sign = dt < 0 ? -1 : 1;
+        std::vector<int32_t> best(count, -1);
+        std::vector<W> score(count, limit);
+        
+        // A heliocentric scheme drifts every body around the star already,
+        // and would apply the star's pull twice to a pair with it.
+        const std::size_t first = scheme_->heliocentric() ? 1 : 0;
+        
+        pool.run(count, GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+            for(auto i = std::max(begin, first); i < end; ++i) {
+                vec3<W> xi = particles.position(i), vi = particles.velocity(i), ai = particles.acceleration(i);
+                for(std::size_t j = first; j < count; ++j) {
+                    W mu = G * (W(particles.mass[i]) + particles.mass[j]);
+                    if(j == i || mu <= 0) { continue; }
+                    
+                    // Closest approach along straight lines over the step.
+                    vec3<W> d = xi - vec3<W>(particles.position(j));
+                    vec3<W> w = sign * (vi - vec3<W>(particles.velocity(j)));
+                    W ww = vec3<W>::dot(w, w);
+                    W t = ww > 0 ? std::min(span, std::max(W(0), -vec3<W>::dot(d, w) / ww)) : W(0);
+                    W closest = (d + t * w).magnitude();
+                    W time = closest * closest * closest / mu;
+                    if(!(time < score[i])) { continue; }
+                    
+                    W r = d.magnitude();
+                    vec3<W> pull = (mu / (r * r * r)) * d;
+                    vec3<W> perturbation = ai - vec3<W>(particles.acceleration(j)) + pull;
+                    if(perturbation.magnitude() > W(PERTURBATION) * pull.magnitude()) { continue; }
+                    best[i] = j;
+                    score[i] = time;
+                }
+            }
+        });
+        
+        std::vector<uint32_t> order;
+        for(std::size_t i = 0; i < count; ++i) {
+            if(best[i] >= 0) { order.push_back(i); }
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return score[a] < score[b]; });
+        
+        partners_.assign(count, -1);
+        pairs_.clear();
+        for(auto i : order) {
+            auto j = best[i];
+            if(partners_[i] >= 0 || partners_[j] >= 0) { continue; }
+            partners_[i] = j;
+            partners_[j] = i;
+            pairs_.push_back(Pair{uint32_t(i), uint32_t(j), vec3<W>(), vec3<W>()});
+        }
+    }
+    
+    template <typename T>
+    void Regularised<T>::orbit(Particles<T>& particles, T dt) {
+        const W G = Physics::G;
+        for(const auto& pair : pairs_) {
+            auto i = pair.first, j = pair.second;
+            W mi = particles.mass[i], mj = particles.mass[j], mass = mi + mj;
+            vec3<W> xi = particles.position(i), xj = particles.position(j);
+            vec3<W> vi = particles.velocity(i), vj = particles.velocity(j);
+            vec3<W> center = (mi * xi + mj * xj) / mass;
+            vec3<W> momentum = (mi * vi + mj * vj) / mass;
+            
+            vec3<W> position = xi - xj;
+            vec3<W> velocity = vi - vj;
+            // The universal variable propagator, which takes Halley steps on
+            // the same equation, stands in should the solve not converge.
+            if(!kepler(position, velocity, G * mass, W(dt))) {
+                Orbit::propagate(position, velocity, G * mass, W(dt));
+            }
+            particles.setPosition(i, center + (mj / mass) * position);
+            particles.setPosition(j, center - (mi / mass) * position);
+            particles.setVelocity(i, momentum + (mj / mass) * velocity);
+            particles.setVelocity(j, momentum - (mi / mass) * velocity);
+        }
+    }
+    
+    template <typename T>
+    void Regularised<T>::start(Particles<T>& particles, const Forces<T>& forces) {
+        pairs_.clear();
+        paired_ = false;
+        scheme_->start(particles, forces);
+    }
+    
+    template <typename T>
+    T Regularised<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        pair(particles, dt, forces.pool);
+        if(pairs_.empty()) {
+            if(paired_) {
+                scheme_->start(particles, forces);
+                paired_ = false;
+            }
+            return scheme_->step(particles, forces, dt);
+        }
+        
+        orbit(particles, T(dt / 2));
+        
+        // The wrapped scheme moves both bodies of a pair with its centre of
+        // mass, and their relative position is put back once it is done.
+        for(auto& pair : pairs_) {
+            auto i = pair.first, j = pair.second;
+            W mi = particles.mass[i], mj = particles.mass[j];
+            vec3<W> vi = particles.velocity(i), vj = particles.velocity(j);
+            vec3<W> momentum = (mi * vi + mj * vj) / (mi + mj);
+            pair.position = vec3<W>(particles.position(i)) - vec3<W>(particles.position(j));
+            pair.velocity = vi - vj;
+            particles.setVelocity(i, momentum);
+            particles.setVelocity(j, momentum);
+        }
+        
+        // The scheme starts afresh: the pairs have moved since its last step,
+        // and their mutual pull is left out of the forces it sees.
+        Forces<T> split{forces.gravity, forces.pool, &partners_};
+        split(particles);
+        scheme_->start(particles, split);
+        paired_ = true;
+        T covered = 0;
+        while(std::abs(covered) < std::abs(dt)) {
+            covered += scheme_->step(particles, split, dt - covered);
+        }
+        
+        for(const auto& pair : pairs_) {
+            auto i = pair.first, j = pair.second;
+            W mi = particles.mass[i], mj = particles.mass[j], mass = mi + mj;
+            vec3<W> xi = particles.position(i), xj = particles.position(j);
+            vec3<W> vi = particles.velocity(i), vj = particles.velocity(j);
+            vec3<W> center = (mi * xi + mj * xj) / mass;
+            vec3<W> momentum = (mi * vi + mj * vj) / mass;
+            vec3<W> velocity = pair.velocity + (vi - vj);
+            particles.setPosition(i, center + (mj / mass) * pair.position);
+            particles.setPosition(j, center - (mi / mass) * pair.position);
+            particles.setVelocity(i, momentum + (mj / mass) * velocity);
+            particles.setVelocity(j, momentum - (mi / mass) * velocity);
+        }
+        
+        orbit(particles, T(dt / 2));
+        forces(particles);
+        return covered;
+    }
+
+#define INSTANTIATE(T) template class Regularised<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
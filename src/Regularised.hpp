@@ -0,0 +1,69 @@
+//
+// exo
+// Regularised.hpp - Kustaanheimo-Stiefel regularisation of close pairs.
+//
+// Two bodies passing close pull on each other so hard that a step which
+// suits the rest of the system throws them off their paths. Before every
+// step, pairs whose own orbital time is short next to the step are picked
+// out, and their motion about each other under their mutual pull is taken
+// away from the wrapped scheme. It is solved exactly in Kustaanheimo-Stiefel
+// coordinates, where the two-body problem becomes a harmonic oscillator in
+// a fictitious time and a collision is a regular point. The wrapped scheme
+// still moves each pair's centre of mass, and the pull of every other body
+// kicks the velocities of both, and so their relative velocity too.
+//
+// A step moves the pairs for half of it, runs the wrapped scheme over all
+// of it, and moves the pairs for the other half, which keeps the split
+// second order. Steps with no close pair go straight to the wrapped scheme.
+//
+// The star is never paired under a heliocentric scheme like Wisdom-Holman,
+// whose drifts move every body around it already.
+//
+#pragma once
+#include <memory>
+#include <vector>
+#include "Scheme.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class Regularised : public Scheme<T> {
+    public:
+        
+        typedef Scalar::Wide<T> W;
+        
+        explicit Regularised(std::unique_ptr<Scheme<T>> scheme);
+        
+        void start(Particles<T>& particles, const Forces<T>& forces) override;
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+        // Moves one body relative to another, along their two-body orbit for
+        // dt, in KS coordinates. mu is G times their total mass. Returns false,
+        // and leaves the state as it was, if the solve for the fictitious time
+        // does not converge.
+        static bool kepler(vec3<W>& position, vec3<W>& velocity, W mu, W dt);
+    
+    private:
+        
+        struct Pair {
+            uint32_t    first;
+            uint32_t    second;
+            vec3<W>     position;   // of first relative to second
+            vec3<W>     velocity;
+        };
+        
+        // Finds the close pairs for a step of dt, closest first, with no
+        // body in more than one, and fills in partners_.
+        void pair(const Particles<T>& particles, T dt, ThreadPool& pool);
+        
+        // Moves the bodies of every pair along their two-body orbit for dt,
+        // keeping their centre of mass where it is.
+        void orbit(Particles<T>& particles, T dt);
+        
+        std::unique_ptr<Scheme<T>>  scheme_;
+        std::vector<Pair>           pairs_;
+        std::vector<int32_t>        partners_;
+        bool                        paired_ = false;    // last started with pairs
+    };
+}
@@ -0,0 +1,152 @@
+//
+// exo
+// Scheme.cpp - Scheme selection and whole-system kicks and drifts.
+//
+#include "Scheme.hpp"
+#include "BlockVerlet.hpp"
+#include "BulirschStoer.hpp"
+#include "Composition.hpp"
+#include "Hermite.hpp"
+#include "Ias15.hpp"
+#include "Parareal.hpp"
+#include "Physics.hpp"
+#include "Regularised.hpp"
+#include "VelocityVerlet.hpp"
+#include "WisdomHolman.hpp"
+
+namespace Integrator {
+    
+    // Bodies per thread below which kicks and drifts are not worth splitting.
+    static const std::size_t GRAIN = 2048;
+    
+    template <typename T>
+    std::unique_ptr<Scheme<T>> Scheme<T>::named(const std::string& name, const Config& config) {
+        if(config.slices > 0) {
+            Config fine = config;
+            fine.slices = 0;
+            if(!named(name, fine)) { return nullptr; }
+            return std::unique_ptr<Scheme>(new Parareal<T>(name, fine, config.slices));
+        }
+        // The hybrid scheme hands its close pairs to Bulirsch-Stoer itself.
+        if(config.regularise && name != "hybrid") {
+            Config wrapped = config;
+            wrapped.regularise = false;
+            auto scheme = named(name, wrapped);
+            if(!scheme) { return nullptr; }
+            return std::unique_ptr<Scheme>(new Regularised<T>(std::move(scheme)));
+        }
+        if(name == "verlet") {
+            return std::unique_ptr<Scheme>(new VelocityVerlet<T>(config.compensated));
+        }
+        if(name == "block") {
+            return std::unique_ptr<Scheme>(new BlockVerlet<T>(config.compensated));
+        }
+        if(name == "hermite") {
+            return std::unique_ptr<Scheme>(new Hermite<T>(true));
+        }
+        if(name == "hermite-block") {
+            return std::unique_ptr<Scheme>(new Hermite<T>(false));
+        }
+        if(name == "forest-ruth") {
+            return std::unique_ptr<Scheme>(Composition<T>::forestRuth(config.compensated));
+        }
+        if(name == "yoshida4") {
+            return std::unique_ptr<Scheme>(Composition<T>::yoshida(4, config.compensated));
+        }
+        if(name == "yoshida6") {
+            return std::unique_ptr<Scheme>(Composition<T>::yoshida(6, config.compensated));
+        }
+        if(name == "yoshida8") {
+            return std::unique_ptr<Scheme>(Composition<T>::yoshida(8, config.compensated));
+        }
+        if(name == "wh") {
+            return std::unique_ptr<Scheme>(new WisdomHolman<T>(false));
+        }
+        if(name == "hybrid") {
+            return std::unique_ptr<Scheme>(new WisdomHolman<T>(true));
+        }
+        if(name == "ias15") {
+            return std::unique_ptr<Scheme>(new Ias15<T>());
+        }
+        if(name == "bs") {
+            return std::unique_ptr<Scheme>(new BulirschStoer<T>());
+        }
+        return nullptr;
+    }
+    
+    template <typename T>
+    void Forces<T>::unpair(Particles<T>& particles, const std::vector<uint32_t>* active, Jerks<T>* jerks) const {
+        typedef Scalar::Wide<T> W;
+        const W G = Physics::G;
+        const auto count = active ? active->size() : particles.size();
+        for(std::size_t k = 0; k < count; ++k) {
+            auto i = active ? (*active)[k] : k;
+            auto j = (*partners)[i];
+            if(j < 0) { continue; }
+            
+            vec3<W> d = vec3<W>(particles.position(j)) - vec3<W>(particles.position(i));
+            W invR2 = 1 / vec3<W>::dot(d, d);
+            W invR3 = G * particles.mass[j] * invR2 * std::sqrt(invR2);
+            particles.setAcceleration(i, vec3<W>(particles.acceleration(i)) - invR3 * d);
+            if(jerks) {
+                vec3<W> dv = vec3<W>(particles.velocity(j)) - vec3<W>(particles.velocity(i));
+                vec3<W> jerk = invR3 * (dv - (3 * vec3<W>::dot(d, dv) * invR2) * d);
+                jerks->x[i] -= jerk.x;
+                jerks->y[i] -= jerk.y;
+                jerks->z[i] -= jerk.z;
+            }
+        }
+    }
+    
+    template <typename T>
+    void kick(Particles<T>& particles, Particles<T>* carry, T dt, ThreadPool& pool) {
+        pool.run(particles.size(), GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+            for(auto body = begin; body < end; ++body) {
+                auto state = particles.state(body);
+                if(carry) {
+                    auto velocityCarry = carry->velocity(body);
+                    kick(state, velocityCarry, dt);
+                    carry->setVelocity(body, velocityCarry);
+                } else {
+                    kick(state, dt);
+                }
+                particles.setVelocity(body, state.velocity);
+            }
+        });
+    }
+    
+    template <typename T>
+    void drift(Particles<T>& particles, Particles<T>* carry, T dt, ThreadPool& pool) {
+        pool.run(particles.size(), GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+            for(auto body = begin; body < end; ++body) {
+                auto state = particles.state(body);
+                if(carry) {
+                    auto positionCarry = carry->position(body);
+                    drift(state, positionCarry, dt);
+                    carry->setPosition(body, positionCarry);
+                } else {
+                    drift(state, dt);
+                }
+                particles.setPosition(body, state.position);
+            }
+        });
+    }
+    
+    template <typename T>
+    void resetCarry(Particles<T>& carry, std::size_t count) {
+        carry = Particles<T>{};
+        State<T> zero;
+        for(std::size_t i = 0; i < count; ++i) {
+            carry.push_back(zero, 0);
+        }
+    }
+    
+#define INSTANTIATE(T) \
+    template struct Forces<T>; \
+    template class Scheme<T>; \
+    template void kick(Particles<T>&, Particles<T>*, T, ThreadPool&); \
+    template void drift(Particles<T>&, Particles<T>*, T, ThreadPool&); \
+    template void resetCarry(Particles<T>&, std::size_t);
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
@@ -0,0 +1,128 @@
+//
+// exo
+// Scheme.hpp - Whole-system integration schemes.
+//
+// A scheme advances every body of a Particles set at once. It asks for the
+// accelerations of the whole system once per stage, so a step costs as many
+// force passes as the scheme has stages, whatever the number of bodies, and
+// no body is ever moved against forces computed from a half-updated system.
+//
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Gravity.hpp"
+#include "Particles.hpp"
+#include "ThreadPool.hpp"
+
+namespace Integrator {
+    
+    // Fills in the accelerations of a whole system from its positions, with
+    // the simulation's gravity solver and threads.
+    template <typename T>
+    struct Forces {
+        Gravity<T>&     gravity;
+        ThreadPool&     pool;
+        
+        // Per body, the partner whose pull is left out of its acceleration,
+        // or -1. Null if every pull counts.
+        const std::vector<int32_t>*     partners = nullptr;
+        
+        void operator()(Particles<T>& particles) const {
+            gravity.accelerate(particles, pool);
+            if(partners) { unpair(particles, nullptr, nullptr); }
+        }
+        
+        // Only fills in the accelerations of the listed bodies.
+        void operator()(Particles<T>& particles, const std::vector<uint32_t>& active) const {
+            gravity.accelerateSubset(particles, active, pool);
+            if(partners) { unpair(particles, &active, nullptr); }
+        }
+        
+        // Also fills in their jerks, summed exactly.
+        void operator()(Particles<T>& particles, const std::vector<uint32_t>& active, Jerks<T>& jerks) const {
+            gravity.accelerateWithJerk(particles, active, jerks, pool);
+            if(partners) { unpair(particles, &active, &jerks); }
+        }
+        
+        // Takes each partner's pull back out of the accelerations, and jerks
+        // if not null, of the listed bodies or of every body. What is left is
+        // exact to the rounding error of the whole sum.
+        void unpair(Particles<T>& particles, const std::vector<uint32_t>* active, Jerks<T>* jerks) const;
+    };
+    
+    // Tuning knobs for the schemes, ignored by those they do not apply to.
+    struct Config {
+        bool        compensated = false;    // carry rounding errors over
+        bool        regularise  = false;    // move close pairs in KS coordinates
+        unsigned    slices      = 0;        // Parareal time slices, 0 for none
+        std::string solver      = "direct"; // gravity solver of each slice's thread
+        GravityConfig gravity;              // and its knobs
+    };
+    
+    template <typename T>
+    class Scheme {
+    public:
+        
+        virtual ~Scheme() {}
+        
+        // Called once before the first step, when the accelerations of the
+        // particles are up to date.
+        virtual void start(Particles<T>& particles, const Forces<T>& forces) {}
+        
+        // Advances the whole system by dt, or by less if the scheme adapts
+        // its step, and returns the time actually covered. Accelerations are
+        // up to date on return.
+        virtual T step(Particles<T>& particles, const Forces<T>& forces, T dt) = 0;
+        
+        // Whether the scheme moves every body around body 0 on its own, so
+        // that no pair with body 0 may be taken out of its hands.
+        virtual bool heliocentric() const { return false; }
+        
+        // Returns the scheme called name ("verlet", "block", "hermite",
+        // "hermite-block", "forest-ruth", "yoshida4", "yoshida6", "yoshida8",
+        // "wh", "hybrid", "ias15", "bs"), or nullptr if there is no such scheme.
+        // With slices set in config, it runs in each slice of a Parareal step.
+        static std::unique_ptr<Scheme> named(const std::string& name, const Config& config);
+    };
+    
+    // Block timesteps divide a step of dt into TICKS ticks. A body at level
+    // l steps at dt / 2^l, TICKS >> l ticks long, and only starts a step on
+    // a tick that is a multiple of that length.
+    static const int MAX_LEVEL = 16;
+    static const uint32_t TICKS = 1u << MAX_LEVEL;
+    
+    // Level a body whose step should be desired long takes out of dt, no
+    // coarser than the grid at tick now allows. A desired length of 0 puts
+    // no limit on the step.
+    template <typename T>
+    int level(T desired, T dt, uint32_t now) {
+        int level = 0;
+        if(desired > 0) {
+            T h = dt;
+            while(h > desired && level < MAX_LEVEL) {
+                h /= 2;
+                ++level;
+            }
+        }
+        while(now % (TICKS >> level) != 0) {
+            ++level;
+        }
+        return level;
+    }
+    
+    // Applies every body's acceleration to its velocity for dt. If carry is
+    // not null, its velocities hold the rounding errors of the updates.
+    template <typename T>
+    void kick(Particles<T>& particles, Particles<T>* carry, T dt, ThreadPool& pool);
+    
+    // Moves every body along its velocity for dt. If carry is not null, its
+    // positions hold the rounding errors of the updates.
+    template <typename T>
+    void drift(Particles<T>& particles, Particles<T>* carry, T dt, ThreadPool& pool);
+    
+    // Empties carry and fills it with count bodies at rest at the origin,
+    // ready to pick up the rounding errors of kicks and drifts.
+    template <typename T>
+    void resetCarry(Particles<T>& carry, std::size_t count);
+}
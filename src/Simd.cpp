@@ -0,0 +1,375 @@
+//
+// exo
+// Simd.cpp - Vectorised direct-sum gravity kernels with runtime dispatch.
+//
+// Each instruction set gets its own function compiled with a target
+// attribute, so the rest of the program keeps the default architecture flags
+// and only calls into a kernel once the CPU has been checked for it.
+//
+// The inverse square root starts from the hardware estimate and is polished
+// with Newton-Raphson steps, y' = y (3 - r2 y^2) / 2, each of which doubles the
+// number of correct bits: one step brings the 12-bit SSE/AVX estimate to float
+// precision, three bring it to double. AVX-512 has a 14-bit estimate for
+// doubles directly and needs two. The SSE2 and AVX2 estimates go through
+// float, so vectors where r2 is out of float range take an exact square root.
+//
+// The pull is gm / r^3, built as ((gm / r) / r) / r: 1 / r^3 on its own goes
+// subnormal in float beyond about 30 AU and loses digits with distance.
+//
+#include <cfloat>
+#include <cmath>
+#include <initializer_list>
+#include "Simd.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EXO_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Simd {
+    
+    template <typename T>
+    static void scalar(const T* x, const T* y, const T* z, const T* gm, std::size_t count,
+                       std::size_t begin, std::size_t end, T* ax, T* ay, T* az) {
+        for(std::size_t i = begin; i < end; ++i) {
+            T sx = 0, sy = 0, sz = 0;
+            for(std::size_t j = 0; j < count; ++j) {
+                T dx = x[j] - x[i];
+                T dy = y[j] - y[i];
+                T dz = z[j] - z[i];
+                T r2 = dx*dx + dy*dy + dz*dz;
+                if(r2 == 0) { continue; }
+                T inv = 1 / std::sqrt(r2);
+                T s = (gm[j] * inv) * inv * inv;
+                sx += s * dx;
+                sy += s * dy;
+                sz += s * dz;
+            }
+            ax[i] = sx;
+            ay[i] = sy;
+            az[i] = sz;
+        }
+    }
+    
+#ifdef EXO_SIMD_X86
+    
+    // MARK: - SSE2
+    
+    __attribute__((target("sse2")))
+    static inline double sum(__m128d v) {
+        return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+    }
+    
+    __attribute__((target("sse2")))
+    static inline float sum(__m128 v) {
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+        return _mm_cvtss_f32(v);
+    }
+    
+    __attribute__((target("sse2")))
+    static void sse2(const double* x, const double* y, const double* z, const double* gm, std::size_t count,
+                     std::size_t begin, std::size_t end, double* ax, double* ay, double* az) {
+        const __m128d zero = _mm_setzero_pd();
+        const __m128d half = _mm_set1_pd(0.5);
+        const __m128d threeHalves = _mm_set1_pd(1.5);
+        const __m128d low = _mm_set1_pd(FLT_MIN);
+        const __m128d high = _mm_set1_pd(FLT_MAX);
+        
+        for(std::size_t i = begin; i < end; ++i) {
+            const __m128d xi = _mm_set1_pd(x[i]);
+            const __m128d yi = _mm_set1_pd(y[i]);
+            const __m128d zi = _mm_set1_pd(z[i]);
+            __m128d sx = zero, sy = zero, sz = zero;
+            
+            for(std::size_t j = 0; j < count; j += 2) {
+                __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + j), xi);
+                __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + j), yi);
+                __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + j), zi);
+                __m128d r2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+                __m128d inv;
+                
+                __m128d range = _mm_or_pd(_mm_cmplt_pd(r2, low), _mm_cmpgt_pd(r2, high));
+                if(_mm_movemask_pd(range)) {
+                    inv = _mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(r2));
+                } else {
+                    __m128d h = _mm_mul_pd(half, r2);
+                    inv = _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(r2)));
+                    for(int k = 0; k < 3; ++k) {
+                        inv = _mm_mul_pd(inv, _mm_sub_pd(threeHalves, _mm_mul_pd(_mm_mul_pd(h, inv), inv)));
+                    }
+                }
+                inv = _mm_and_pd(inv, _mm_cmpgt_pd(r2, zero));
+                
+                __m128d s = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(gm + j), inv), inv), inv);
+                sx = _mm_add_pd(sx, _mm_mul_pd(s, dx));
+                sy = _mm_add_pd(sy, _mm_mul_pd(s, dy));
+                sz = _mm_add_pd(sz, _mm_mul_pd(s, dz));
+            }
+            ax[i] = sum(sx);
+            ay[i] = sum(sy);
+            az[i] = sum(sz);
+        }
+    }
+    
+    __attribute__((target("sse2")))
+    static void sse2(const float* x, const float* y, const float* z, const float* gm, std::size_t count,
+                     std::size_t begin, std::size_t end, float* ax, float* ay, float* az) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 threeHalves = _mm_set1_ps(1.5f);
+        
+        for(std::size_t i = begin; i < end; ++i) {
+            const __m128 xi = _mm_set1_ps(x[i]);
+            const __m128 yi = _mm_set1_ps(y[i]);
+            const __m128 zi = _mm_set1_ps(z[i]);
+            __m128 sx = zero, sy = zero, sz = zero;
+            
+            for(std::size_t j = 0; j < count; j += 4) {
+                __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), xi);
+                __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), yi);
+                __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + j), zi);
+                __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                
+                __m128 inv = _mm_rsqrt_ps(r2);
+                inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(half, r2), inv), inv)));
+                inv = _mm_and_ps(inv, _mm_cmpgt_ps(r2, zero));
+                
+                __m128 s = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(gm + j), inv), inv), inv);
+                sx = _mm_add_ps(sx, _mm_mul_ps(s, dx));
+                sy = _mm_add_ps(sy, _mm_mul_ps(s, dy));
+                sz = _mm_add_ps(sz, _mm_mul_ps(s, dz));
+            }
+            ax[i] = sum(sx);
+            ay[i] = sum(sy);
+            az[i] = sum(sz);
+        }
+    }
+    
+    // MARK: - AVX2
+    
+    __attribute__((target("avx2,fma")))
+    static inline double sum(__m256d v) {
+        __m128d h = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+    }
+    
+    __attribute__((target("avx2,fma")))
+    static inline float sum(__m256 v) {
+        __m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+        h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+        return _mm_cvtss_f32(h);
+    }
+    
+    __attribute__((target("avx2,fma")))
+    static void avx2(const double* x, const double* y, const double* z, const double* gm, std::size_t count,
+                     std::size_t begin, std::size_t end, double* ax, double* ay, double* az) {
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d half = _mm256_set1_pd(0.5);
+        const __m256d threeHalves = _mm256_set1_pd(1.5);
+        const __m256d low = _mm256_set1_pd(FLT_MIN);
+        const __m256d high = _mm256_set1_pd(FLT_MAX);
+        
+        for(std::size_t i = begin; i < end; ++i) {
+            const __m256d xi = _mm256_set1_pd(x[i]);
+            const __m256d yi = _mm256_set1_pd(y[i]);
+            const __m256d zi = _mm256_set1_pd(z[i]);
+            __m256d sx = zero, sy = zero, sz = zero;
+            
+            for(std::size_t j = 0; j < count; j += 4) {
+                __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+                __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+                __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), zi);
+                __m256d r2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+                __m256d inv;
+                
+                __m256d range = _mm256_or_pd(_mm256_cmp_pd(r2, low, _CMP_LT_OQ), _mm256_cmp_pd(r2, high, _CMP_GT_OQ));
+                if(_mm256_movemask_pd(range)) {
+                    inv = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(r2));
+                } else {
+                    __m256d h = _mm256_mul_pd(half, r2);
+                    inv = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+                    for(int k = 0; k < 3; ++k) {
+                        inv = _mm256_mul_pd(inv, _mm256_fnmadd_pd(_mm256_mul_pd(h, inv), inv, threeHalves));
+                    }
+                }
+                inv = _mm256_and_pd(inv, _mm256_cmp_pd(r2, zero, _CMP_GT_OQ));
+                
+                __m256d s = _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(gm + j), inv), inv), inv);
+                sx = _mm256_fmadd_pd(s, dx, sx);
+                sy = _mm256_fmadd_pd(s, dy, sy);
+                sz = _mm256_fmadd_pd(s, dz, sz);
+            }
+            ax[i] = sum(sx);
+            ay[i] = sum(sy);
+            az[i] = sum(sz);
+        }
+    }
+    
+    __attribute__((target("avx2,fma")))
+    static void avx2(const float* x, const float* y, const float* z, const float* gm, std::size_t count,
+                     std::size_t begin, std::size_t end, float* ax, float* ay, float* az) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 threeHalves = _mm256_set1_ps(1.5f);
+        
+        for(std::size_t i = begin; i < end; ++i) {
+            const __m256 xi = _mm256_set1_ps(x[i]);
+            const __m256 yi = _mm256_set1_ps(y[i]);
+            const __m256 zi = _mm256_set1_ps(z[i]);
+            __m256 sx = zero, sy = zero, sz = zero;
+            
+            for(std::size_t j = 0; j < count; j += 8) {
+                __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xi);
+                __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yi);
+                __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), zi);
+                __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+                
+                __m256 inv = _mm256_rsqrt_ps(r2);
+                inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(_mm256_mul_ps(half, r2), inv), inv, threeHalves));
+                inv = _mm256_and_ps(inv, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+                
+                __m256 s = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(gm + j), inv), inv), inv);
+                sx = _mm256_fmadd_ps(s, dx, sx);
+                sy = _mm256_fmadd_ps(s, dy, sy);
+                sz = _mm256_fmadd_ps(s, dz, sz);
+            }
+            ax[i] = sum(sx);
+            ay[i] = sum(sy);
+            az[i] = sum(sz);
+        }
+    }
+    
+    // MARK: - AVX-512
+    
+    __attribute__((target("avx512f")))
+    static void avx512(const double* x, const double* y, const double* z, const double* gm, std::size_t count,
+                       std::size_t begin, std::size_t end, double* ax, double* ay, double* az) {
+        const __m512d zero = _mm512_setzero_pd();
+        const __m512d half = _mm512_set1_pd(0.5);
+        const __m512d threeHalves = _mm512_set1_pd(1.5);
+        
+        for(std::size_t i = begin; i < end; ++i) {
+            const __m512d xi = _mm512_set1_pd(x[i]);
+            const __m512d yi = _mm512_set1_pd(y[i]);
+            const __m512d zi = _mm512_set1_pd(z[i]);
+            __m512d sx = zero, sy = zero, sz = zero;
+            
+            for(std::size_t j = 0; j < count; j += 8) {
+                __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), xi);
+                __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), yi);
+                __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + j), zi);
+                __m512d r2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+                
+                __m512d h = _mm512_mul_pd(half, r2);
+                __m512d inv = _mm512_rsqrt14_pd(r2);
+                for(int k = 0; k < 2; ++k) {
+                    inv = _mm512_mul_pd(inv, _mm512_fnmadd_pd(_mm512_mul_pd(h, inv), inv, threeHalves));
+                }
+                inv = _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(r2, zero, _CMP_GT_OQ), inv);
+                
+                __m512d s = _mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(_mm512_loadu_pd(gm + j), inv), inv), inv);
+                sx = _mm512_fmadd_pd(s, dx, sx);
+                sy = _mm512_fmadd_pd(s, dy, sy);
+                sz = _mm512_fmadd_pd(s, dz, sz);
+            }
+            ax[i] = _mm512_reduce_add_pd(sx);
+            ay[i] = _mm512_reduce_add_pd(sy);
+            az[i] = _mm512_reduce_add_pd(sz);
+        }
+    }
+    
+    __attribute__((target("avx512f")))
+    static void avx512(const float* x, const float* y, const float* z, const float* gm, std::size_t count,
+                       std::size_t begin, std::size_t end, float* ax, float* ay, float* az) {
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512 half = _mm512_set1_ps(0.5f);
+        const __m512 threeHalves = _mm512_set1_ps(1.5f);
+        
+        for(std::size_t i = begin; i < end; ++i) {
+            const __m512 xi = _mm512_set1_ps(x[i]);
+            const __m512 yi = _mm512_set1_ps(y[i]);
+            const __m512 zi = _mm512_set1_ps(z[i]);
+            __m512 sx = zero, sy = zero, sz = zero;
+            
+            for(std::size_t j = 0; j < count; j += 16) {
+                __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(x + j), xi);
+                __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(y + j), yi);
+                __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(z + j), zi);
+                __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+                
+                __m512 inv = _mm512_rsqrt14_ps(r2);
+                inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(_mm512_mul_ps(_mm512_mul_ps(half, r2), inv), inv, threeHalves));
+                inv = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(r2, zero, _CMP_GT_OQ), inv);
+                
+                __m512 s = _mm512_mul_ps(_mm512_mul_ps(_mm512_mul_ps(_mm512_loadu_ps(gm + j), inv), inv), inv);
+                sx = _mm512_fmadd_ps(s, dx, sx);
+                sy = _mm512_fmadd_ps(s, dy, sy);
+                sz = _mm512_fmadd_ps(s, dz, sz);
+            }
+            ax[i] = _mm512_reduce_add_ps(sx);
+            ay[i] = _mm512_reduce_add_ps(sy);
+            az[i] = _mm512_reduce_add_ps(sz);
+        }
+    }
+    
+#endif
+    
+    // MARK: - Dispatch
+    
+    bool supported(Isa isa) {
+#ifdef EXO_SIMD_X86
+        __builtin_cpu_init();
+        switch(isa) {
+            case Isa::SCALAR:
+                return true;
+            case Isa::SSE2:
+                return __builtin_cpu_supports("sse2");
+            case Isa::AVX2:
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            case Isa::AVX512:
+                return __builtin_cpu_supports("avx512f");
+        }
+        return false;
+#else
+        return isa == Isa::SCALAR;
+#endif
+    }
+    
+    Isa best() {
+        static const Isa isa = [] {
+            for(Isa isa : {Isa::AVX512, Isa::AVX2, Isa::SSE2}) {
+                if(supported(isa)) { return isa; }
+            }
+            return Isa::SCALAR;
+        }();
+        return isa;
+    }
+    
+    const char* name(Isa isa) {
+        switch(isa) {
+            case Isa::SCALAR:   return "scalar";
+            case Isa::SSE2:     return "sse2";
+            case Isa::AVX2:     return "avx2";
+            case Isa::AVX512:   return "avx512";
+        }
+        return "unknown";
+    }
+    
+    template <typename T>
+    Kernel<T> kernel(Isa isa) {
+#ifdef EXO_SIMD_X86
+        switch(isa) {
+            case Isa::SSE2:     return &sse2;
+            case Isa::AVX2:     return &avx2;
+            case Isa::AVX512:   return &avx512;
+            default:            break;
+        }
+#endif
+        return &scalar<T>;
+    }
+    
+    template Kernel<double> kernel<double>(Isa isa);
+    template Kernel<float> kernel<float>(Isa isa);
+}
@@ -0,0 +1,45 @@
+//
+// exo
+// Simd.hpp - Vectorised direct-sum gravity kernels with runtime dispatch.
+//
+// Every kernel computes the acceleration of a range of target bodies from all
+// the sources in structure-of-arrays form, in double or single precision.
+// The variant is picked from what the CPU supports when the program runs, so
+// one binary uses AVX-512 where it can and falls back to AVX2, SSE2 or plain
+// scalar code elsewhere.
+//
+#pragma once
+#include <cstddef>
+
+namespace Simd {
+    
+    enum class Isa {
+        SCALAR,
+        SSE2,
+        AVX2,
+        AVX512
+    };
+    
+    // Arrays handed to the kernels must hold a multiple of this many bodies.
+    // Padding bodies should have no mass.
+    const std::size_t PADDING = 16;
+    
+    // Accelerations of the targets [begin, end) from every source in
+    // [0, count). gm holds G times each source's mass. A source at the exact
+    // position of its target, the target itself included, is ignored.
+    template <typename T>
+    using Kernel = void (*)(const T* x, const T* y, const T* z, const T* gm, std::size_t count,
+                            std::size_t begin, std::size_t end, T* ax, T* ay, T* az);
+    
+    // Whether the CPU running the program can execute a given variant.
+    bool supported(Isa isa);
+    
+    // The widest supported variant, probed once.
+    Isa best();
+    
+    const char* name(Isa isa);
+    
+    // Returns the kernel for an instruction set, which must be supported.
+    template <typename T>
+    Kernel<T> kernel(Isa isa);
+}
@@ -0,0 +1,75 @@
+//
+// exo
+// SimdDirect.cpp - Vectorised O(N^2) direct-sum gravity solver.
+//
+#include <algorithm>
+#include "SimdDirect.hpp"
+#include "Physics.hpp"
+
+static const std::size_t GRAIN = 64;
+
+template <typename T, typename K>
+SimdDirect<T, K>::SimdDirect(Simd::Isa isa) : isa_(isa), kernel_(Simd::kernel<K>(isa)) {
+    
+}
+
+template <typename T, typename K>
+void SimdDirect<T, K>::accelerate(Particles<T>& particles, ThreadPool& pool) {
+    const auto count = particles.size();
+    auto pad = [](std::size_t n) { return (n + Simd::PADDING - 1) / Simd::PADDING * Simd::PADDING; };
+    
+    // Bodies with mass are packed first, as the kernel's sources, and test
+    // particles after them, as targets only.
+    slot_.clear();
+    for(uint32_t i = 0; i < count; ++i) {
+        if(particles.mass[i] != 0) { slot_.push_back(i); }
+    }
+    const auto sources = slot_.size();
+    for(uint32_t i = 0; i < count; ++i) {
+        if(particles.mass[i] == 0) { slot_.push_back(i); }
+    }
+    const auto padded = pad(sources);
+    const auto total = pad(padded + count - sources);
+    
+    // Padding bodies sit at the origin with no mass and pull on nothing.
+    x_.assign(total, 0);
+    y_.assign(total, 0);
+    z_.assign(total, 0);
+    gm_.assign(total, 0);
+    ax_.resize(total);
+    ay_.resize(total);
+    az_.resize(total);
+    
+    // Target t is packed at t, or past the padding for test particles.
+    auto packed = [&](std::size_t t) { return t < sources ? t : t - sources + padded; };
+    for(std::size_t t = 0; t < count; ++t) {
+        auto i = slot_[t];
+        auto k = packed(t);
+        x_[k] = particles.x[i];
+        y_[k] = particles.y[i];
+        z_[k] = particles.z[i];
+        gm_[k] = Physics::G * particles.mass[i];
+    }
+    
+    pool.run(count, GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+        std::size_t ranges[2][2] = {
+            {begin, std::min(end, sources)},
+            {std::max(begin, sources), end}
+        };
+        for(const auto& range : ranges) {
+            if(range[0] >= range[1]) { continue; }
+            kernel_(x_.data(), y_.data(), z_.data(), gm_.data(), padded,
+                    packed(range[0]), packed(range[1] - 1) + 1, ax_.data(), ay_.data(), az_.data());
+            for(auto t = range[0]; t < range[1]; ++t) {
+                auto i = slot_[t];
+                auto k = packed(t);
+                particles.ax[i] = ax_[k];
+                particles.ay[i] = ay_[k];
+                particles.az[i] = az_[k];
+            }
+        }
+    });
+}
+
+#define INSTANTIATE(T) template class SimdDirect<T, double>; template class SimdDirect<T, float>;
+EXO_INSTANTIATE_SCALARS(INSTANTIATE)
@@ -0,0 +1,35 @@
+//
+// exo
+// SimdDirect.hpp - Vectorised O(N^2) direct-sum gravity solver.
+//
+// Positions and masses are copied out of the Particles<T> of the simulation,
+// whatever its scalar type, into padded arrays of the kernel's type K, double
+// or float. Every body sums the pull of every other one there with the
+// widest SIMD kernel the CPU supports, and the accelerations are copied back
+// into the particles as T. This visits each pair twice, unlike DirectSum,
+// but at two to sixteen pairs per instruction. Test particles are packed
+// after the bodies with mass, as targets only, never sources.
+//
+#pragma once
+#include <vector>
+#include "Gravity.hpp"
+#include "Simd.hpp"
+
+// T is the simulation's scalar type, K the one the kernel computes in.
+template <typename T, typename K>
+class SimdDirect : public Gravity<T> {
+public:
+    
+    explicit SimdDirect(Simd::Isa isa = Simd::best());
+    
+    void accelerate(Particles<T>& particles, ThreadPool& pool) override;
+    
+    Simd::Isa isa() const { return isa_; }
+    
+private:
+    Simd::Isa               isa_;
+    Simd::Kernel<K>         kernel_;
+    std::vector<K>          x_, y_, z_, gm_;
+    std::vector<K>          ax_, ay_, az_;
+    std::vector<uint32_t>   slot_;      // body of each target, sources first
+};
@@ -5,13 +5,12 @@
 //  Created by Amy Parent on 06/03/2017.
 //  Copyright © 2017 Amy Parent. All rights reserved.
 //
-#include <functional>
 #include <cstdlib>
 #include <algorithm>
 #include "json.hpp"
 #include "StarSystem.hpp"
 #include "Physics.hpp"
-#include "Orbit.hpp"
+#include "Elements.hpp"
 #include "Model.hpp"
 
 using json = nlohmann::json;
@@ -27,7 +26,15 @@ T get(const json& data, const std::string& key, T fallback) {
     return fallback;
 }
 
-StarSystem::StarSystem(std::istream& jsonFile, long double julianDate) {
+template <typename T>
+StarSystem<T>::StarSystem(std::istream& jsonFile, long double julianDate,
+                          std::unique_ptr<Gravity<T>> gravity,
+                          std::unique_ptr<Integrator::Scheme<T>> scheme, unsigned threads,
+                          long double testMass)
+: start_(julianDate)
+, pool_(threads)
+, gravity_(std::move(gravity))
+, scheme_(std::move(scheme)) {
     
     nextBody_ = 1;
     ticksToTrail_ = 0;
@@ -45,27 +52,35 @@ StarSystem::StarSystem(std::istream& jsonFile, long double julianDate) {
     
     auto& star = data["star"];
     
-    Integrator::State state {
-        Vector3{0.0, 0.0, 0.0},
-        Vector3{-20.0, 0.0, 0.0},
-        Vector3{0.0, 0.0, 0.0}
+    star_ = Integrator::State<T> {
+        vec3<T>{0.0, 0.0, 0.0},
+        vec3<T>{-20.0, 0.0, 0.0},
+        vec3<T>{0.0, 0.0, 0.0}
     };
     
     bodies_.push_back(Body{
         get<std::string>(star, "name", "SYSTEM a"),
         Renderer::Color::YELLOW,
-        state,
-        get(star, "mass", 1.0) * Physics::Msol,
+        star_.position,
         get(star, "radius", 1.0) * Physics::Rsol
     });
+    particles_.push_back(star_, get(star, "mass", 1.0) * Physics::Msol);
     
+    // Test particles feel the other bodies without pulling on them, and are
+    // given no mass. They go after every massive body, which lets the direct
+    // sums stop their outer loops at the last source.
+    auto isTest = [&](const json& body) {
+        return get(body, "test", false) || get(body, "mass", 1.0) * Physics::Mearth < testMass;
+    };
+    std::vector<const json*> entries;
+    for(bool tests : {false, true}) {
+        for(auto& body : data["bodies"]) {
+            if(isTest(body) == tests) { entries.push_back(&body); }
+        }
+    }
     
-    // Keep track of the raw orbits, we can only get valid state vectors once
-    // we know where the barycenter of the whole system is
-    
-    std::vector<Orbit> orbits_;
-    
-    for(auto& body : data["bodies"]) {
+    for(auto* entry : entries) {
+        auto& body = *entry;
         char ID = 'b';
         
         auto color = Renderer::Color::LIGHTBLUE;
@@ -73,142 +88,185 @@ StarSystem::StarSystem(std::istream& jsonFile, long double julianDate) {
             color = Renderer::colorNamed(body["color"].get<std::string>());
         }
         
-        long double mass = get(body, "mass", 1.0) * Physics::Mearth;
-        auto orbit = Orbit::Builder()
-            .semiMajorAxis(get(body, "sma", 1.0) * Physics::AU)
-            .eccentricity(get(body, "ecc", 0.0))
-            .inclination(get(body, "inc", 0.0))
-            .argOfPeriapsis(get(body, "arg", 0.0))
-            .rightAscension(get(body, "raan", 0.0))
-            .meanAnomaly(get(body, "ma", 0.0))
-            .epoch(get(body, "epoch", Physics::J2000))
-            .build();
-        //std::cout << orbit << std::endl;
-        
-        // First estimation, we only use that to get the position - velocity
-        // will not be accurate until we have a complete system mass and
-        // barycenter location.
-        auto stateVectors = orbit.stateVectors((bodies_[0].mass + mass) * Physics::G, julianDate);
-        //std::cout << "\t-> " << stateVectors.first << ", " << stateVectors.second << std::endl;
-        
-        Integrator::State state {
-            stateVectors.first,
-            stateVectors.second,
-            Vector3{}
-        };
+        long double mass = isTest(body) ? 0 : get(body, "mass", 1.0) * Physics::Mearth;
+        orbits_.push_back(get(body, "sma", 1.0) * Physics::AU,
+                          get(body, "ecc", 0.0),
+                          radians(get(body, "inc", 0.0)),
+                          radians(get(body, "arg", 0.0)),
+                          radians(get(body, "raan", 0.0)),
+                          radians(get(body, "ma", 0.0)),
+                          get(body, "epoch", Physics::J2000));
         
         bodies_.push_back(Body{
             get<std::string>(body, "name", "SYSTEM" + std::to_string(ID++)),
             color,
-            state,
-            mass,
+            Vector3{},
             get(body, "radius", 1.0) * Physics::Rearth
         });
-        // const auto& B = bodies_.back();
-        // std::cout << "Found " << B.name << " with radius: " << B.radius / Physics::Rearth << std::endl;
-        orbits_.push_back(orbit);
+        particles_.push_back(Integrator::State<T>{vec3<T>{}, vec3<T>{}, vec3<T>{}}, mass);
+    }
+    // We can only get valid state vectors once we know where the barycenter
+    // of the whole system is. ephemeris() places its own copy the same way.
+    ephemeris_ = particles_;
+    place(particles_, julianDate);
+    for(size_t i = 0; i < particles_.size(); ++i) {
+        bodies_[i].position = particles_.position(i);
     }
     
-    Vector3 barycenter{};
-    Vector3 momentum{};
-    long double mass = 0;
+    Integrator::Forces<T> forces{*gravity_, pool_};
+    forces(particles_);
+    scheme_->start(particles_, forces);
+}
+
+
+template <typename T>
+void StarSystem<T>::place(Particles<T>& particles, long double julianDate) {
+    particles.setPosition(0, star_.position);
+    particles.setVelocity(0, star_.velocity);
     
-    for(auto& body : bodies_) {
-        barycenter  += body.mass * body.state.position;
-        mass        += body.mass;
+    // First estimation, we only use that to get the position - velocity
+    // will not be accurate until we have a complete system mass and
+    // barycenter location.
+    std::vector<W> GM;
+    for(size_t i = 1; i < particles.size(); ++i) {
+        GM.push_back((W(particles.mass[0]) + particles.mass[i]) * Physics::G);
     }
+    orbits_.stateVectors(GM, julianDate, particles, 1, pool_);
     
-    barycenter /= mass;
+    // Mass-weighted sums overflow a float, so they are done in at least double.
+    vec3<W> barycenter{};
+    vec3<W> momentum{};
+    W mass = 0;
     
-    for(size_t i = 1; i < bodies_.size(); ++i) {
-        auto& body = bodies_[i];
-        auto& orbit = orbits_[i-1];
-        
-        auto stateVectors = orbit.stateVectors(mass * Physics::G, julianDate);
-        body.state.position = stateVectors.first;
-        body.state.velocity = stateVectors.second;
+    for(size_t i = 0; i < particles.size(); ++i) {
+        barycenter  += W(particles.mass[i]) * vec3<W>(particles.position(i));
+        mass        += particles.mass[i];
     }
     
-    for(auto& body : bodies_) {
-        momentum += body.mass * body.state.velocity;
+    barycenter /= mass;
+    
+    std::fill(GM.begin(), GM.end(), mass * Physics::G);
+    orbits_.stateVectors(GM, julianDate, particles, 1, pool_);
+    
+    for(size_t i = 0; i < particles.size(); ++i) {
+        momentum += W(particles.mass[i]) * vec3<W>(particles.velocity(i));
     }
     momentum /= mass;
+    
+    for(size_t i = 0; i < particles.size(); ++i) {
+        particles.setPosition(i, vec3<W>(particles.position(i)) - barycenter);
+        particles.setVelocity(i, vec3<W>(particles.velocity(i)) - momentum);
+    }
+}
 
-    for(auto& body: bodies_) {
-        body.state.position -= barycenter;
-        body.state.velocity -= momentum;
+template <typename T>
+void StarSystem<T>::show(const Particles<T>& particles) {
+    for(size_t b = 0; b < bodies_.size(); ++b) {
+        bodies_[b].position = particles.position(b);
+        bodies_[b].trail.clear();
+    }
+    ticksToTrail_ = 0;
+}
+
+template <typename T>
+void StarSystem<T>::ephemeris(long double julianDate) {
+    place(ephemeris_, julianDate);
+    if(!analytic_) {
+        show(ephemeris_);
+        analytic_ = true;
+    }
+    
+    // Every evaluation is a frame, and leaves a point of the trails.
+    for(size_t b = 0; b < bodies_.size(); ++b) {
+        auto& trail = bodies_[b].trail;
+        bodies_[b].position = ephemeris_.position(b);
+        trail.push_front(bodies_[b].position);
+        if(trail.size() > TRAIL_SIZE) {
+            trail.pop_back();
+        }
     }
 }
 
+template <typename T>
+void StarSystem<T>::resume() {
+    if(!analytic_) { return; }
+    show(particles_);
+    analytic_ = false;
+}
 
-const StarSystem::Body* StarSystem::nextBody() const {
+template <typename T>
+const typename StarSystem<T>::Body* StarSystem<T>::nextBody() const {
     if(bodies_.size() <= 0) { return NULL; }
     const Body* b = &bodies_[nextBody_];
     nextBody_ = (nextBody_ + 1) % bodies_.size();
     return b;
 }
 
-double StarSystem::maxDiameter() {
+template <typename T>
+double StarSystem<T>::maxDiameter() {
     double radius = 0;
     
-    for(auto& body : bodies_) {
-        auto sma = body.state.position.magnitude();
+    for(size_t i = 0; i < particles_.size(); ++i) {
+        auto sma = particles_.position(i).magnitude();
         if(sma <= 0) { continue; }
         if(sma > radius) {
             radius = sma;
         }
     }
     return radius * 2;
-    //return bodies_[0].state.position.magnitude() * 2;
 }
 
-Vector3 StarSystem::accelerate(const Integrator::State& state, double mass) {
-    Vector3 forces;
-    
-    for(auto& body: previous_) {
-        if(body.name == integrating_) { continue; }
-        
-        auto ray = (body.state.position - state.position).normalized();
-        forces += ray * Physics::gravity(state.position, mass, body.state.position, body.mass);
-    }
-    return forces / mass;
-}
-
-using namespace std::placeholders;
-
-double StarSystem::advance(int iterations, double delta) {
+template <typename T>
+double StarSystem<T>::advance(int iterations, double delta) {
+    Integrator::Forces<T> forces{*gravity_, pool_};
+    double elapsed = 0;
+    resume();
     
     for(int i = 0; i < iterations; ++i) {
-        previous_ = bodies_;
-        for(auto& body: bodies_) {
-            integrating_ = body.name;
-            body.state = Integrator::advance(body.state,
-                                             body.mass,
-                                             std::bind(&StarSystem::accelerate, this, _1, _2),
-                                             delta);
+        double dt = scheme_->step(particles_, forces, delta);
+        elapsed += dt;
+        elapsed_ += dt;
+        if(stream_) {
+            stream_->step(particles_, start_ + elapsed_.value() / 86400.0L);
         }
+        
         if(ticksToTrail_-- == 0) {
             ticksToTrail_ = TRAIL_TICK;
             
-            for(auto& body: bodies_) {
-                body.trail.push_front(body.state.position);
-                if(body.trail.size() > TRAIL_SIZE) {
-                    body.trail.pop_back();
+            for(size_t b = 0; b < bodies_.size(); ++b) {
+                auto& trail = bodies_[b].trail;
+                trail.push_front(particles_.position(b));
+                if(trail.size() > TRAIL_SIZE) {
+                    trail.pop_back();
                 }
             }
         }
     }
     
-    return delta * iterations;
+    for(size_t b = 0; b < bodies_.size(); ++b) {
+        bodies_[b].position = particles_.position(b);
+    }
+    
+    return elapsed;
+}
+
+template <typename T>
+void StarSystem<T>::record(std::ostream& out, unsigned decimation, typename Elements<T>::Centre centre, bool lossy) {
+    std::vector<std::string> names;
+    for(const auto& body : bodies_) {
+        names.push_back(body.name);
+    }
+    stream_.reset(new ElementStream<T>(out, names, decimation, centre, lossy));
 }
 
-void StarSystem::render(Renderer &renderer) {
+template <typename T>
+void StarSystem<T>::render(Renderer &renderer) {
     for(auto& body: bodies_) {
         renderer.setColor(body.color);
-        renderer.drawModel(Model::sphereInstance(), body.state.position, 10*body.radius);
-        //renderer.drawCircle(body.state.position, 4);
-        renderer.drawString(body.state.position + Vector3{0, 0, 10*body.radius}, body.name);
-        Vector3 previous = body.state.position;
+        renderer.drawModel(Model::sphereInstance(), body.position, 10*body.radius);
+        //renderer.drawCircle(body.position, 4);
+        renderer.drawString(body.position + Vector3{0, 0, 10*body.radius}, body.name);
+        Vector3 previous = body.position;
         
         int it = TRAIL_SIZE-1;
         for(auto& p : body.trail) {
@@ -223,3 +281,5 @@ void StarSystem::render(Renderer &renderer) {
     }
 }
 
+#define INSTANTIATE(T) template class StarSystem<T>;
+EXO_INSTANTIATE_SCALARS(INSTANTIATE)
@@ -7,6 +7,7 @@
 //
 #pragma once
 #include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -14,42 +15,105 @@
 #include "Math/vec3.hpp"
 #include "Renderer.hpp"
 #include "Integrator.hpp"
+#include "Particles.hpp"
+#include "Gravity.hpp"
+#include "Scheme.hpp"
+#include "ThreadPool.hpp"
 #include "Orbit.hpp"
+#include "Elements.hpp"
+#include "ElementStream.hpp"
+#include "Math/Compensated.hpp"
 
+// T is the scalar type the system is integrated in. Rendering always works
+// on long double copies of the positions.
+template <typename T>
 class StarSystem {
 public:
     
+    // Cold, per-body data. The integrated state lives in particles_, and
+    // position is only a copy refreshed once per advance() for rendering.
     struct Body {
         std::string         name;
         Renderer::Color     color;
-        Integrator::State   state;
-        long double         mass;
+        Vector3             position;
         long double         radius;
         std::deque<Vector3> trail;
     };
     
-    StarSystem(std::istream& jsonFile, long double julianDate);
+    // Bodies flagged "test" in the file, or lighter than testMass, are test
+    // particles: they move in the field of the others but have no mass.
+    StarSystem(std::istream& jsonFile, long double julianDate,
+               std::unique_ptr<Gravity<T>> gravity,
+               std::unique_ptr<Integrator::Scheme<T>> scheme, unsigned threads = 0,
+               long double testMass = 0);
     
     ~StarSystem() {}
     
     double maxDiameter();
     
+    // Takes iterations steps of delta seconds and returns the time actually
+    // simulated, which adaptive schemes can make shorter.
     double advance(int iterations, double delta);
     
+    // Moves the bodies to where their orbits from the file put them at the
+    // given Julian date, without integrating: every orbit is evaluated on its
+    // own, so a jump of a century costs as much as one of a second. The
+    // integrated state is left alone, and resume() or advance() shows the
+    // bodies there again.
+    void ephemeris(long double julianDate);
+    
+    // Shows the integrated bodies again after ephemeris().
+    void resume();
+    
     void render(Renderer& renderer);
     
     const Body* nextBody() const;
     
     const std::vector<Body>& bodies() const { return bodies_; }
     
+    const Particles<T>& particles() const { return particles_; }
+    
+    // Writes the osculating elements of the bodies to out every decimation
+    // steps from now on, measured from the given centre. Steps only wait if
+    // the writer falls behind, or never if lossy is set and records are
+    // dropped instead. out must outlive the system.
+    void record(std::ostream& out, unsigned decimation, typename Elements<T>::Centre centre, bool lossy);
+    
+    // Measures the gravity solver against the direct sum on a sample of the
+    // system's bodies.
+    GravityError gravityError(size_t samples) { return gravity_->error(particles_, samples, pool_); }
+
 private:
-    Vector3 accelerate(const Integrator::State& state, double mass);
     
-    std::string         integrating_;
+    typedef Scalar::Wide<T> W;
+    
+    // Places bodies 1 onwards of particles on their orbits at the given
+    // Julian date, and moves the whole system to its barycentre frame.
+    void place(Particles<T>& particles, long double julianDate);
+    
+    // Clears the trails and shows the bodies where particles has them.
+    void show(const Particles<T>& particles);
+    
     int                 ticksToTrail_;
     
     mutable uint64_t    nextBody_;
     std::vector<Body>   bodies_;
-    std::vector<Body>   previous_;
+    Particles<T>        particles_;
+    
+    // The orbits from the file, the star's state before the move to the
+    // barycentre, and the bodies ephemeris() last placed.
+    Elements<T>         orbits_;
+    Integrator::State<T> star_;
+    Particles<T>        ephemeris_;
+    bool                analytic_ = false;
+    
+    // Date the integration started at, and seconds integrated since.
+    long double         start_;
+    Compensated<double> elapsed_;
+    std::unique_ptr<ElementStream<T>> stream_;
+    
+    ThreadPool          pool_;
+    std::unique_ptr<Gravity<T>> gravity_;
+    std::unique_ptr<Integrator::Scheme<T>> scheme_;
     
 };
@@ -0,0 +1,99 @@
+//
+// exo
+// ThreadPool.cpp - Persistent pool of worker threads.
+//
+#include <algorithm>
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned threads)
+: task_(nullptr)
+, count_(0)
+, active_(0)
+, pending_(0)
+, generation_(0)
+, stop_(false) {
+    if(threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for(unsigned i = 1; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for(auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::threadsFor(std::size_t count, std::size_t grain) const {
+    std::size_t threads = count / std::max<std::size_t>(grain, 1);
+    return std::max<std::size_t>(1, std::min<std::size_t>(threads, size()));
+}
+
+static void chunk(std::size_t count, unsigned threads, unsigned thread,
+                  std::size_t& begin, std::size_t& end) {
+    begin = count * thread / threads;
+    end = count * (thread + 1) / threads;
+}
+
+void ThreadPool::run(std::size_t count, std::size_t grain, const Task& task) {
+    unsigned threads = threadsFor(count, grain);
+    if(threads == 1) {
+        task(0, count, 0);
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        active_ = threads;
+        pending_ = threads - 1;
+        generation_ += 1;
+    }
+    wake_.notify_all();
+    
+    std::size_t begin, end;
+    chunk(count, threads, 0, begin, end);
+    task(begin, end, 0);
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    task_ = nullptr;
+}
+
+void ThreadPool::work(unsigned thread) {
+    uint64_t seen = 0;
+    
+    for(;;) {
+        const Task* task = nullptr;
+        std::size_t count = 0;
+        unsigned threads = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if(stop_) { return; }
+            seen = generation_;
+            if(thread >= active_) { continue; }
+            task = task_;
+            count = count_;
+            threads = active_;
+        }
+        
+        std::size_t begin, end;
+        chunk(count, threads, thread, begin, end);
+        (*task)(begin, end, thread);
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_ -= 1;
+        }
+        done_.notify_one();
+    }
+}
@@ -0,0 +1,57 @@
+//
+// exo
+// ThreadPool.hpp - Persistent pool of worker threads for data-parallel loops.
+//
+// Workers are started once and sleep between jobs, so a parallel loop costs a
+// wake-up rather than a thread creation. The calling thread takes part in
+// every job as thread 0.
+//
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    
+    // Runs on the range [begin, end) as the given thread.
+    typedef std::function<void(std::size_t begin, std::size_t end, unsigned thread)> Task;
+    
+    // Starts threads-1 workers. Zero picks the number of hardware threads.
+    explicit ThreadPool(unsigned threads = 0);
+    
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    unsigned size() const { return workers_.size() + 1; }
+    
+    // Number of threads run() uses for count items, given that splitting
+    // below grain items per thread is not worth the wake-up.
+    unsigned threadsFor(std::size_t count, std::size_t grain) const;
+    
+    // Splits [0, count) into one contiguous chunk per thread and runs task on
+    // each, returning once they are all done. Small jobs run inline.
+    void run(std::size_t count, std::size_t grain, const Task& task);
+    
+private:
+    
+    void work(unsigned thread);
+    
+    std::vector<std::thread>    workers_;
+    std::mutex                  mutex_;
+    std::condition_variable     wake_;
+    std::condition_variable     done_;
+    
+    const Task*                 task_;
+    std::size_t                 count_;
+    unsigned                    active_;
+    unsigned                    pending_;
+    uint64_t                    generation_;
+    bool                        stop_;
+};
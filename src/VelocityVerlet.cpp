@@ -0,0 +1,27 @@
+//
+// exo
+// VelocityVerlet.cpp - Kick-drift-kick velocity Verlet scheme.
+//
+#include "VelocityVerlet.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    void VelocityVerlet<T>::start(Particles<T>& particles, const Forces<T>& forces) {
+        resetCarry(carry_, compensated_ ? particles.size() : 0);
+    }
+    
+    template <typename T>
+    T VelocityVerlet<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        auto* carry = compensated_ ? &carry_ : nullptr;
+        kick(particles, carry, T(0.5 * dt), forces.pool);
+        drift(particles, carry, dt, forces.pool);
+        forces(particles);
+        kick(particles, carry, T(0.5 * dt), forces.pool);
+        return dt;
+    }
+    
+#define INSTANTIATE(T) template class VelocityVerlet<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
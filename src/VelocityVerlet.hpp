@@ -0,0 +1,30 @@
+//
+// exo
+// VelocityVerlet.hpp - Kick-drift-kick velocity Verlet scheme.
+//
+// Second order and symplectic, with one force pass per step: half a kick,
+// a full drift, new accelerations for the whole system, and the closing half
+// kick, applied to every body at once rather than one body at a time.
+//
+#pragma once
+#include "Scheme.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class VelocityVerlet : public Scheme<T> {
+    public:
+        
+        // With compensated set, rounding errors of the position and velocity
+        // updates are carried over from step to step.
+        explicit VelocityVerlet(bool compensated) : compensated_(compensated) {}
+        
+        void start(Particles<T>& particles, const Forces<T>& forces) override;
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+    private:
+        bool            compensated_;
+        Particles<T>    carry_;
+    };
+}
@@ -0,0 +1,318 @@
+//
+// exo
+// WisdomHolman.cpp - Wisdom-Holman mixed-variable symplectic scheme.
+//
+#include <algorithm>
+#include <cmath>
+#include "WisdomHolman.hpp"
+#include "Orbit.hpp"
+#include "Physics.hpp"
+
+namespace Integrator {
+    
+    // Bodies per thread below which Kepler drifts are not worth splitting.
+    static const std::size_t GRAIN = 256;
+    
+    // A body's changeover distance is HILL of its Hill radii, or SPEED times
+    // the distance it covers in a step if that is longer, as in MERCURY. Both
+    // are measured on its orbit when the scheme starts, from its semi-major
+    // axis, so they stay put over an eccentric orbit and across steps.
+    static const double HILL = 3;
+    static const double SPEED = 0.4;
+    
+    // Bodies per thread in the search for close pairs, each checked against
+    // all those after it.
+    static const std::size_t PAIR_GRAIN = 64;
+    
+    // Share of a pull at distance r that the kicks apply, for a changeover
+    // distance radius: none within a tenth of it, all of it beyond, and
+    // Chambers' quintic in between, smooth to the second derivative.
+    template <typename W>
+    static W weight(W r, W radius) {
+        W y = (r - W(0.1) * radius) / (W(0.9) * radius);
+        if(y <= 0) { return 0; }
+        if(y >= 1) { return 1; }
+        return y * y * y * (10 - 15 * y + 6 * y * y);
+    }
+    
+    // Pulls on the bodies of a group while they drift: the star's, and the
+    // drift's share of their pulls on one another. Positions are relative to
+    // the star.
+    template <typename T>
+    class Changeover : public Gravity<T> {
+    public:
+        
+        typedef Scalar::Wide<T> W;
+        
+        Changeover(W GM, const std::vector<T>& radius) : GM_(GM), radius_(radius) {}
+        
+        void accelerate(Particles<T>& particles, ThreadPool& pool) override {
+            const W G = Physics::G;
+            for(std::size_t i = 0; i < particles.size(); ++i) {
+                vec3<W> x = particles.position(i);
+                W r = x.magnitude();
+                vec3<W> a = (-GM_ / (r * r * r)) * x;
+                for(std::size_t j = 0; j < particles.size(); ++j) {
+                    if(j == i || particles.mass[j] == 0) { continue; }
+                    vec3<W> d = vec3<W>(particles.position(j)) - x;
+                    W rij = d.magnitude();
+                    W share = 1 - weight(rij, W(std::max(radius_[i], radius_[j])));
+                    a += (share * G * particles.mass[j] / (rij * rij * rij)) * d;
+                }
+                particles.setAcceleration(i, a);
+            }
+        }
+        
+    private:
+        W                       GM_;
+        const std::vector<T>&   radius_;    // of the bodies of the group
+    };
+    
+    template <typename T>
+    void WisdomHolman<T>::toHeliocentric(const Particles<T>& particles) {
+        const auto count = particles.size();
+        W mass = 0;
+        barycenter_ = vec3<W>{};
+        momentum_ = vec3<W>{};
+        for(std::size_t i = 0; i < count; ++i) {
+            barycenter_ += W(particles.mass[i]) * vec3<W>(particles.position(i));
+            momentum_ += W(particles.mass[i]) * vec3<W>(particles.velocity(i));
+            mass += particles.mass[i];
+        }
+        barycenter_ /= mass;
+        momentum_ /= mass;
+        
+        vec3<W> star = particles.position(0);
+        for(std::size_t i = 1; i < count; ++i) {
+            helio_.setPosition(i, vec3<W>(particles.position(i)) - star);
+            helio_.setVelocity(i, vec3<W>(particles.velocity(i)) - momentum_);
+        }
+    }
+    
+    template <typename T>
+    void WisdomHolman<T>::fromHeliocentric(Particles<T>& particles, T dt) const {
+        const auto count = particles.size();
+        const W GM = W(Physics::G) * particles.mass[0];
+        W mass = 0;
+        vec3<W> offset{};
+        vec3<W> momentum{};
+        vec3<W> pull{};
+        
+        for(std::size_t i = 0; i < count; ++i) {
+            mass += particles.mass[i];
+        }
+        
+        for(std::size_t i = 1; i < count; ++i) {
+            vec3<W> p = helio_.position(i);
+            W m = particles.mass[i];
+            W r = p.magnitude();
+            offset += m * p;
+            momentum += m * vec3<W>(helio_.velocity(i));
+            pull += (W(Physics::G) * m / (r * r * r)) * p;
+            particles.setAcceleration(i, vec3<W>(helio_.acceleration(i)) - (GM / (r * r * r)) * p);
+        }
+        
+        vec3<W> star = barycenter_ + W(dt) * momentum_ - offset / mass;
+        particles.setPosition(0, star);
+        particles.setVelocity(0, momentum_ - momentum / W(particles.mass[0]));
+        particles.setAcceleration(0, pull);
+        
+        for(std::size_t i = 1; i < count; ++i) {
+            particles.setPosition(i, star + vec3<W>(helio_.position(i)));
+            particles.setVelocity(i, momentum_ + vec3<W>(helio_.velocity(i)));
+        }
+    }
+    
+    template <typename T>
+    void WisdomHolman<T>::interactions(const Forces<T>& forces) {
+        forces(helio_);
+        helio_.setAcceleration(0, vec3<T>{0, 0, 0});
+    }
+    
+    template <typename T>
+    void WisdomHolman<T>::jump(W starMass, T dt) {
+        vec3<W> momentum{};
+        for(std::size_t i = 1; i < helio_.size(); ++i) {
+            momentum += W(helio_.mass[i]) * vec3<W>(helio_.velocity(i));
+        }
+        vec3<W> shift = (W(dt) / starMass) * momentum;
+        for(std::size_t i = 1; i < helio_.size(); ++i) {
+            helio_.setPosition(i, vec3<W>(helio_.position(i)) + shift);
+        }
+    }
+    
+    template <typename T>
+    void WisdomHolman<T>::encounters(T dt, ThreadPool& pool) {
+        const auto count = helio_.size();
+        const W span = std::abs(W(dt));
+        const W sign = dt < 0 ? -1 : 1;
+        
+        if(radius_.size() != count || span != span_) {
+            span_ = span;
+            radius_.assign(count, 0);
+            for(std::size_t i = 1; i < count; ++i) {
+                radius_[i] = std::max(W(HILL) * hill_[i], W(SPEED) * speed_[i] * span);
+            }
+        }
+        
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> found(pool.size());
+        pool.run(count, PAIR_GRAIN, [&](std::size_t begin, std::size_t end, unsigned thread) {
+            for(auto i = std::max<std::size_t>(begin, 1); i < end; ++i) {
+                vec3<W> xi = helio_.position(i), vi = helio_.velocity(i);
+                for(auto j = i + 1; j < count; ++j) {
+                    if(helio_.mass[i] == 0 && helio_.mass[j] == 0) { continue; }
+                    
+                    // Closest approach along straight lines over the step.
+                    vec3<W> d = xi - vec3<W>(helio_.position(j));
+                    vec3<W> w = sign * (vi - vec3<W>(helio_.velocity(j)));
+                    W ww = vec3<W>::dot(w, w);
+                    W t = ww > 0 ? std::min(span, std::max(W(0), -vec3<W>::dot(d, w) / ww)) : W(0);
+                    if((d + t * w).magnitude() < std::max(radius_[i], radius_[j])) {
+                        found[thread].emplace_back(i, j);
+                    }
+                }
+            }
+        });
+        
+        // Groups are the connected sets of close pairs, found by union-find.
+        std::vector<uint32_t> root(count);
+        for(std::size_t i = 0; i < count; ++i) { root[i] = i; }
+        auto find = [&](uint32_t i) {
+            while(root[i] != i) { i = root[i] = root[root[i]]; }
+            return i;
+        };
+        close_.clear();
+        for(const auto& pairs : found) {
+            for(const auto& pair : pairs) {
+                close_.push_back(pair);
+                root[find(pair.first)] = find(pair.second);
+            }
+        }
+        
+        group_.assign(count, -1);
+        groups_.clear();
+        std::vector<int32_t> index(count, -1);
+        for(const auto& pair : close_) {
+            for(auto i : {pair.first, pair.second}) {
+                if(group_[i] >= 0) { continue; }
+                auto r = find(i);
+                if(index[r] < 0) {
+                    index[r] = groups_.size();
+                    groups_.emplace_back();
+                }
+                group_[i] = index[r];
+                groups_[index[r]].push_back(i);
+            }
+        }
+    }
+    
+    template <typename T>
+    void WisdomHolman<T>::withdraw(T dt) {
+        const W G = Physics::G;
+        for(const auto& pair : close_) {
+            auto i = pair.first, j = pair.second;
+            vec3<W> d = vec3<W>(helio_.position(j)) - vec3<W>(helio_.position(i));
+            W r = d.magnitude();
+            W share = 1 - weight(r, W(std::max(radius_[i], radius_[j])));
+            if(share == 0) { continue; }
+            
+            vec3<W> pull = (W(dt) * share * G / (r * r * r)) * d;
+            helio_.setVelocity(i, vec3<W>(helio_.velocity(i)) - W(helio_.mass[j]) * pull);
+            helio_.setVelocity(j, vec3<W>(helio_.velocity(j)) + W(helio_.mass[i]) * pull);
+        }
+    }
+    
+    template <typename T>
+    void WisdomHolman<T>::encounter(W GM, T dt, ThreadPool& pool) {
+        for(const auto& group : groups_) {
+            Particles<T> bodies;
+            std::vector<T> radius;
+            for(auto i : group) {
+                bodies.push_back(helio_.state(i), helio_.mass[i]);
+                radius.push_back(radius_[i]);
+            }
+            
+            Changeover<T> gravity(GM, radius);
+            Forces<T> forces{gravity, pool};
+            forces(bodies);
+            drift_.start(bodies, forces);
+            for(T covered = 0; std::abs(covered) < std::abs(dt);) {
+                covered += drift_.step(bodies, forces, dt - covered);
+            }
+            
+            for(std::size_t k = 0; k < group.size(); ++k) {
+                helio_.setPosition(group[k], bodies.position(k));
+                helio_.setVelocity(group[k], bodies.velocity(k));
+            }
+        }
+    }
+    
+    template <typename T>
+    void WisdomHolman<T>::start(Particles<T>& particles, const Forces<T>& forces) {
+        helio_ = particles;
+        helio_.mass[0] = 0;
+        helio_.setPosition(0, vec3<T>{0, 0, 0});
+        helio_.setVelocity(0, vec3<T>{0, 0, 0});
+        toHeliocentric(particles);
+        interactions(forces);
+        if(!hybrid_) { return; }
+        
+        // Bound bodies are measured at their semi-major axis, on a circular
+        // orbit of that size. Unbound ones have no such orbit, and are
+        // measured where they are.
+        const auto count = particles.size();
+        const W G = Physics::G;
+        const W starMass = particles.mass[0];
+        hill_.assign(count, 0);
+        speed_.assign(count, 0);
+        radius_.clear();
+        for(std::size_t i = 1; i < count; ++i) {
+            vec3<W> x = vec3<W>(particles.position(i)) - vec3<W>(particles.position(0));
+            vec3<W> v = vec3<W>(particles.velocity(i)) - vec3<W>(particles.velocity(0));
+            W GM = G * (starMass + W(particles.mass[i]));
+            W r = x.magnitude();
+            W inverse = 2 / r - vec3<W>::dot(v, v) / GM;
+            W a = inverse > 0 ? 1 / inverse : r;
+            hill_[i] = a * std::cbrt(W(particles.mass[i]) / (3 * starMass));
+            speed_[i] = inverse > 0 ? std::sqrt(GM / a) : v.magnitude();
+        }
+    }
+    
+    template <typename T>
+    T WisdomHolman<T>::step(Particles<T>& particles, const Forces<T>& forces, T dt) {
+        const W GM = W(Physics::G) * particles.mass[0];
+        
+        // The interaction accelerations are left over from the previous step,
+        // whose bodies ended where this one starts.
+        toHeliocentric(particles);
+        if(hybrid_) {
+            encounters(dt, forces.pool);
+        }
+        kick<T>(helio_, nullptr, T(0.5 * dt), forces.pool);
+        withdraw(T(0.5 * dt));
+        jump(particles.mass[0], T(0.5 * dt));
+        
+        forces.pool.run(helio_.size() - 1, GRAIN, [&](std::size_t begin, std::size_t end, unsigned) {
+            for(auto i = begin + 1; i < end + 1; ++i) {
+                if(!group_.empty() && group_[i] >= 0) { continue; }
+                vec3<W> position = helio_.position(i);
+                vec3<W> velocity = helio_.velocity(i);
+                Orbit::propagate<W>(position, velocity, GM, W(dt));
+                helio_.setPosition(i, position);
+                helio_.setVelocity(i, velocity);
+            }
+        });
+        encounter(GM, dt, forces.pool);
+        
+        jump(particles.mass[0], T(0.5 * dt));
+        interactions(forces);
+        kick<T>(helio_, nullptr, T(0.5 * dt), forces.pool);
+        withdraw(T(0.5 * dt));
+        fromHeliocentric(particles, dt);
+        return dt;
+    }
+    
+#define INSTANTIATE(T) template class WisdomHolman<T>;
+    EXO_INSTANTIATE_SCALARS(INSTANTIATE)
+#undef INSTANTIATE
+}
@@ -0,0 +1,90 @@
+//
+// exo
+// WisdomHolman.hpp - Wisdom-Holman mixed-variable symplectic scheme.
+//
+// The motion of every body around the star is solved exactly, and only the
+// much weaker pulls between the other bodies are integrated numerically. The
+// step is limited by how fast those pulls change rather than by the orbits,
+// so it can be far longer than a Verlet step for the same accuracy.
+//
+// Bodies are moved in democratic heliocentric coordinates: positions relative
+// to the star, velocities relative to the barycentre. A step is half an
+// interaction kick, half a star momentum drift, a Kepler drift of every body
+// around the star, the other half of the momentum drift and the closing half
+// kick. The star is always body 0. The Kepler drift is Orbit::propagate, in
+// universal variables, so bodies on near-parabolic and hyperbolic paths lose
+// no digits to orbital elements.
+//
+// The hybrid mode is Chambers' (1999) MERCURY scheme. A pair of bodies
+// coming within a few Hill radii of each other has its pull handed over
+// smoothly from the kicks to the drift, and the bodies of such a pair, and
+// of any other pair they are close to, drift together with the
+// Bulirsch-Stoer scheme instead of along Kepler orbits. Everyone else keeps
+// the cheap map, and the step does not have to shrink for an encounter.
+//
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "BulirschStoer.hpp"
+#include "Scheme.hpp"
+
+namespace Integrator {
+    
+    template <typename T>
+    class WisdomHolman : public Scheme<T> {
+    public:
+        
+        typedef Scalar::Wide<T> W;
+        
+        explicit WisdomHolman(bool hybrid) : hybrid_(hybrid) {}
+        
+        void start(Particles<T>& particles, const Forces<T>& forces) override;
+        
+        T step(Particles<T>& particles, const Forces<T>& forces, T dt) override;
+        
+        bool heliocentric() const override { return true; }
+    
+    private:
+        
+        // Fills in the pulls of the bodies on one another, leaving the star
+        // out, from the heliocentric positions.
+        void interactions(const Forces<T>& forces);
+        
+        // Moves every body by the momentum of the star for dt. The star's mass
+        // is passed in, as helio_ keeps it out of the force passes.
+        void jump(W starMass, T dt);
+        
+        void toHeliocentric(const Particles<T>& particles);
+        void fromHeliocentric(Particles<T>& particles, T dt) const;
+        
+        // Finds the pairs that come within their changeover distance over a
+        // step of dt, and gathers the bodies they link into groups. The
+        // distances are only worked out again if the step length changes.
+        void encounters(T dt, ThreadPool& pool);
+        
+        // Takes the share of the close pairs' pulls that goes with the drift
+        // back out of a kick of dt.
+        void withdraw(T dt);
+        
+        // Drifts the bodies of every group for dt around the star, under the
+        // drift's share of their pulls on one another.
+        void encounter(W GM, T dt, ThreadPool& pool);
+        
+        // Heliocentric positions, barycentric velocities and interaction
+        // accelerations. The star sits at the origin with no mass.
+        Particles<T>    helio_;
+        vec3<W>         barycenter_;
+        vec3<W>         momentum_;  // velocity of the barycentre
+        
+        bool                                            hybrid_;
+        std::vector<W>                                  hill_;      // Hill radius of each body at start
+        std::vector<W>                                  speed_;     // orbital speed of each body at start
+        std::vector<T>                                  radius_;    // changeover distance of each body
+        W                                               span_ = 0;  // step length radius_ was worked out for
+        std::vector<std::pair<uint32_t, uint32_t>>      close_;
+        std::vector<int32_t>                            group_;     // of each body, or -1
+        std::vector<std::vector<uint32_t>>              groups_;
+        BulirschStoer<T>                                drift_;
+    };
+}
@@ -17,7 +17,10 @@
 #include <iterator>
 #include <getopt.h>
 #include "Math/Utils.hpp"
+#include "Math/Compensated.hpp"
+#include "Benchmark.hpp"
 #include "Physics.hpp"
+#include "Gravity.hpp"
 #include "Renderer.hpp"
 #include "StarSystem.hpp"
 
@@ -32,11 +35,29 @@ std::string dateString(time_t seconds) {
 }
 
 void printUsage(const char* calledName) {
-    std::cerr << "usage: " << calledName << " [-w width] [-h height] [-f] [-s step] json_file " << std::endl;
+    std::cerr << "usage: " << calledName << " [-w width] [-h height] [-f] [-s step] [-g solver] [-t theta] [-q] [-o order] [-e samples] [-n threads] [-p precision] [-i integrator] [-c] [-k] [-r slices] [-m mass] [-a] [-x file] [-d steps] [-z] [-l] [-b benchmark] json_file " << std::endl;
     std::cerr << std::endl;
     std::cerr << "\t-w,--width:\twindow width (defaults to 800 pixels)" << std::endl;
     std::cerr << "\t-h,--height:\twindow height (defaults to 600 pixels)" << std::endl;
-    std::cerr << "\t-s,--step:\ttime increment between integration steps (defaults to 60 seconds)" << std::endl;
+    std::cerr << "\t-s,--step:\ttime increment between integration steps, the longest one for block, hermite, ias15 and bs (defaults to 60 seconds)" << std::endl;
+    std::cerr << "\t-g,--gravity:\tgravity solver, direct, tree, fmm, simd or simd-float (defaults to direct)" << std::endl;
+    std::cerr << "\t-t,--theta:\topening angle of the tree and fmm solvers (defaults to 0.5)" << std::endl;
+    std::cerr << "\t-q,--quadrupole:\tuse quadrupole moments in the tree solver" << std::endl;
+    std::cerr << "\t-o,--order:\texpansion order of the fmm solver (defaults to 4)" << std::endl;
+    std::cerr << "\t-e,--error:\treport the solver's error against the direct sum on a sample of bodies" << std::endl;
+    std::cerr << "\t-n,--threads:\tnumber of threads for the simulation (defaults to one per core)" << std::endl;
+    std::cerr << "\t-p,--precision:\tscalar type of the simulation, float, double, long or quad in QUAD=1 builds (defaults to long)" << std::endl;
+    std::cerr << "\t-i,--integrator:\tintegration scheme, verlet, block, hermite, hermite-block, forest-ruth, yoshida4, yoshida6, yoshida8, wh, hybrid, ias15 or bs (defaults to verlet)" << std::endl;
+    std::cerr << "\t-c,--compensated:\tcarry rounding errors over in position and velocity updates" << std::endl;
+    std::cerr << "\t-k,--regularise:\tmove close pairs of bodies in Kustaanheimo-Stiefel coordinates, except with hybrid which has its own treatment" << std::endl;
+    std::cerr << "\t-r,--parareal:\tsplit every step into this many time slices of 64 steps of the integrator, run in parallel with the gravity solver and corrected with Parareal iterations (defaults to 0, off)" << std::endl;
+    std::cerr << "\t-m,--massless:\tmake bodies lighter than this many Earth masses test particles, which feel gravity but exert none (defaults to 0)" << std::endl;
+    std::cerr << "\t-a,--ephemeris:\tstart in ephemeris mode, with bodies placed on their orbits instead of integrated (toggled with E)" << std::endl;
+    std::cerr << "\t-x,--elements:\twrite the osculating elements of the bodies to this file as the simulation runs, on a writer thread the simulation waits for only if it falls behind" << std::endl;
+    std::cerr << "\t-d,--decimation:\tsteps between two sets of elements written (defaults to 100)" << std::endl;
+    std::cerr << "\t-z,--barycentric:\tmeasure the elements written from the barycentre instead of the star" << std::endl;
+    std::cerr << "\t-l,--lossy:\tdrop sets of elements instead of waiting when the writer falls behind, and count them at the end of the file" << std::endl;
+    std::cerr << "\t-b,--benchmark:\trun a benchmark (simd, precision, schemes, accuracy, disk, massless, binary, scattering, parareal, kepler, elements, propagate, osculating) on the given json files and exit" << std::endl;
     std::cerr << "\t-j,--start:\tJulian Date of the simulation's start (defaults to now" << std::endl;
     std::cerr << "\tjson_file:\tjson solar system file" << std::endl;
 }
@@ -45,6 +66,11 @@ static int bodySwitcher = 1;
 static bool showNames = false;
 static float mult = 1;
 
+// In ephemeris mode bodies are placed straight from their orbits, and jumps
+// move the date by whole years at once.
+static bool analytic = false;
+static int jump = 0;
+
 void onKeyDown(Renderer& r, SDL_Scancode key) {
     switch(key) {
         case SDL_SCANCODE_LEFT:
@@ -90,6 +116,15 @@ void onKeyDown(Renderer& r, SDL_Scancode key) {
         case SDL_SCANCODE_TAB:
             showNames = !showNames;
             break;
+        case SDL_SCANCODE_E:
+            analytic = !analytic;
+            break;
+        case SDL_SCANCODE_PAGEUP:
+            jump += 1;
+            break;
+        case SDL_SCANCODE_PAGEDOWN:
+            jump -= 1;
+            break;
         default:
             break;
     }
@@ -123,85 +158,89 @@ void drawBodiyList(Renderer& renderer, const std::vector<std::string>& names, ui
     }
 }
 
-uint64_t changeBody(const StarSystem& system, Renderer& renderer, uint64_t current, int offset) {
+template <typename T>
+uint64_t changeBody(const StarSystem<T>& system, Renderer& renderer, uint64_t current, int offset) {
     const auto& bodies = system.bodies();
     if(bodies.size() == 0) { return -1; }
     
     int64_t target = (current + offset) % bodies.size();
-    if(renderer.setCenter(&(bodies[target].state.position))) {
+    if(renderer.setCenter(&(bodies[target].position))) {
         return target;
     }
     return current;
 }
 
-// Mark: - Program entry point. Should porbably move to an App class
-
-
-int main(int argc, char** args) {
+// Everything the command line sets up for a simulation run.
+struct Options {
+    int                 fullscreen      = 0;
+    uint32_t            width           = 800;
+    uint32_t            height          = 600;
+    double              timestep        = 60.0;
+    long double         startDate       = Physics::julianFromUnix(time(nullptr));
+    const char*         jsonpath        = nullptr;
+    std::string         solver          = "direct";
+    GravityConfig       gravityConfig;
+    size_t              errorSamples    = 0;
+    unsigned            threads         = 0;
+    std::string         integrator      = "verlet";
+    Integrator::Config  integratorConfig;
+    long double         testMass        = 0;
+    bool                analytic        = false;
+    const char*         elementsPath    = nullptr;
+    unsigned            decimation      = 100;
+    bool                barycentric     = false;
+    bool                lossy           = false;
+};
 
-    std::setlocale(LC_ALL, "");
-    int             fullscreen      = 0;
-    uint32_t        width           = 800;
-    uint32_t        height          = 600;
-    double          timestep        = 60.0;
-    long double     startDate       = Physics::julianFromUnix(time(nullptr));
-    const char*     jsonpath        = nullptr;
-    
-    static struct option options[] =
-    {
-        {"width",       required_argument,  nullptr,        'w'},
-        {"height",      required_argument,  nullptr,        'h'},
-        {"step",        required_argument,  nullptr,        's'},
-        {"start",       required_argument,  nullptr,        'j'},
-        {"fullscreen",  no_argument,        &fullscreen,     1 },
-        {NULL, 0, NULL, 0}
-    };
-    
-    int c = -1;
-    while((c = getopt_long(argc, args, "w:h:s:j:f", options, NULL)) != -1) {
-        switch(c) {
-            case 'w':
-                width = std::atoi(optarg);
-                break;
-            case 'h':
-                height = std::atoi(optarg);
-                break;
-            case 's':
-                timestep = std::atof(optarg);
-                break;
-            case 'f':
-                fullscreen = 1;
-                break;
-            case 'j':
-                startDate = std::atof(optarg);
-                break;
-            case '?':
-                printUsage(args[0]);
-                std::exit(EXIT_FAILURE);
-                break;
-            default:
-                break;
-        }
-    }
+// Loads and runs the simulation with T as its scalar type.
+template <typename T>
+int simulate(const Options& options) {
     
-    if(argc - optind != 1) {
-        printUsage(args[0]);
+    auto gravity = Gravity<T>::named(options.solver, options.gravityConfig);
+    if(!gravity) {
+        std::cerr << "error: unknown gravity solver '" << options.solver << "'" << std::endl;
         std::exit(EXIT_FAILURE);
     }
-    jsonpath = args[optind];
     
-    std::ifstream in{jsonpath};
+    std::ifstream in{options.jsonpath};
     
     if(!in.is_open()) {
-        std::cerr << "error: cannot open '" << jsonpath << "' for reading" << std::endl;
+        std::cerr << "error: cannot open '" << options.jsonpath << "' for reading" << std::endl;
         std::exit(EXIT_FAILURE);
     }
     
-    time_t seconds = Physics::unixFromJulian(startDate);
-    StarSystem system{in, startDate};
+    auto scheme = Integrator::Scheme<T>::named(options.integrator, options.integratorConfig);
+    if(!scheme) {
+        std::cerr << "error: unknown integrator '" << options.integrator << "'" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    
+    // The clock is compensated too, so fractional steps add up over long runs
+    // instead of being rounded away frame after frame.
+    Compensated<double> seconds = Physics::unixFromJulian(options.startDate);
+    // Declared before the system, so that the stream is done writing
+    // before the file closes.
+    std::ofstream elements;
+    StarSystem<T> system{in, options.startDate, std::move(gravity), std::move(scheme), options.threads, options.testMass};
     in.close();
     
-    Renderer renderer{width, height, jsonpath, static_cast<bool>(fullscreen)};
+    if(options.elementsPath) {
+        elements.open(options.elementsPath);
+        if(!elements.is_open()) {
+            std::cerr << "error: cannot open '" << options.elementsPath << "' for writing" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        typedef typename Elements<T>::Centre Centre;
+        system.record(elements, options.decimation, options.barycentric ? Centre::BARYCENTRE : Centre::STAR, options.lossy);
+    }
+    
+    if(options.errorSamples > 0) {
+        auto error = system.gravityError(options.errorSamples);
+        std::cout << options.solver << " gravity error over " << options.errorSamples << " bodies: "
+                  << error.mean << " mean, " << error.max << " max" << std::endl;
+    }
+    
+    Renderer renderer{options.width, options.height, options.jsonpath, static_cast<bool>(options.fullscreen)};
     
     renderer.onMouseDrag = &onMouseDrag;
     renderer.onMouseScroll = &onMouseScroll;
@@ -212,10 +251,16 @@ int main(int argc, char** args) {
     std::transform(system.bodies().begin(),
                    system.bodies().end(),
                    std::back_inserter(names),
-                   [](const StarSystem::Body& b){
+                   [](const typename StarSystem<T>::Body& b){
         return b.name;
     });
     
+    // The ephemeris date starts from the integrated one whenever the mode is
+    // switched on, so that the two can be compared.
+    long double date = options.startDate;
+    bool wasAnalytic = false;
+    analytic = options.analytic;
+    
     renderer.setScale(100.0 / system.maxDiameter());
     renderer.start([&](Renderer& renderer) {
         
@@ -228,9 +273,26 @@ int main(int argc, char** args) {
         scrollSpeed *= 0.90f;
         if(scrollSpeed > -0.0001f && scrollSpeed < 0.0001f) { scrollSpeed = 0.f; }
         
-        if(!showNames) {
-            seconds += system.advance(iterations, mult*timestep);
+        if(analytic) {
+            if(!wasAnalytic) {
+                date = Physics::julianFromUnix(seconds.value());
+            }
+            if(!showNames) {
+                date += iterations * mult * options.timestep / 86400.0;
+            }
+            date += jump * 365.25;
+            jump = 0;
+            system.ephemeris(date);
+        } else {
+            if(wasAnalytic) {
+                system.resume();
+            }
+            jump = 0;
+            if(!showNames) {
+                seconds += system.advance(iterations, mult*options.timestep);
+            }
         }
+        wasAnalytic = analytic;
         
         system.render(renderer);
         
@@ -239,10 +301,169 @@ int main(int argc, char** args) {
         }
         
         renderer.setColor(Renderer::Color::WHITE);
-        renderer.drawUIString(Vector3{-0.47, 0.47, 0}, dateString(seconds));
-        renderer.drawUIString(Vector3{-0.47, -0.47, 0}, std::to_string(iterations) + " steps/frame");
+        if(analytic) {
+            renderer.drawUIString(Vector3{-0.47, 0.47, 0}, dateString(Physics::unixFromJulian(date)));
+            renderer.drawUIString(Vector3{-0.47, -0.47, 0}, std::to_string(iterations) + " steps/frame, ephemeris");
+        } else {
+            renderer.drawUIString(Vector3{-0.47, 0.47, 0}, dateString(seconds.value()));
+            renderer.drawUIString(Vector3{-0.47, -0.47, 0}, std::to_string(iterations) + " steps/frame");
+        }
         return true;
     });
     
     return 0;
 }
+
+// Mark: - Program entry point. Should porbably move to an App class
+
+
+int main(int argc, char** args) {
+    
+    std::setlocale(LC_ALL, "");
+    Options         run;
+    std::string     precision       = "long";
+    std::string     benchmark;
+    
+    static struct option options[] =
+    {
+        {"width",       required_argument,  nullptr,        'w'},
+        {"height",      required_argument,  nullptr,        'h'},
+        {"step",        required_argument,  nullptr,        's'},
+        {"start",       required_argument,  nullptr,        'j'},
+        {"gravity",     required_argument,  nullptr,        'g'},
+        {"theta",       required_argument,  nullptr,        't'},
+        {"quadrupole",  no_argument,        nullptr,        'q'},
+        {"order",       required_argument,  nullptr,        'o'},
+        {"error",       required_argument,  nullptr,        'e'},
+        {"threads",     required_argument,  nullptr,        'n'},
+        {"precision",   required_argument,  nullptr,        'p'},
+        {"integrator",  required_argument,  nullptr,        'i'},
+        {"compensated", no_argument,        nullptr,        'c'},
+        {"regularise",  no_argument,        nullptr,        'k'},
+        {"parareal",    required_argument,  nullptr,        'r'},
+        {"massless",    required_argument,  nullptr,        'm'},
+        {"ephemeris",   no_argument,        nullptr,        'a'},
+        {"elements",    required_argument,  nullptr,        'x'},
+        {"decimation",  required_argument,  nullptr,        'd'},
+        {"barycentric", no_argument,        nullptr,        'z'},
+        {"lossy",       no_argument,        nullptr,        'l'},
+        {"benchmark",   required_argument,  nullptr,        'b'},
+        {"fullscreen",  no_argument,        &run.fullscreen, 1 },
+        {NULL, 0, NULL, 0}
+    };
+    
+    int c = -1;
+    while((c = getopt_long(argc, args, "w:h:s:j:g:t:qo:e:n:p:i:ckr:m:ax:d:zlb:f", options, NULL)) != -1) {
+        switch(c) {
+            case 'w':
+                run.width = std::atoi(optarg);
+                break;
+            case 'h':
+                run.height = std::atoi(optarg);
+                break;
+            case 's':
+                run.timestep = std::atof(optarg);
+                break;
+            case 'f':
+                run.fullscreen = 1;
+                break;
+            case 'j':
+                run.startDate = std::atof(optarg);
+                break;
+            case 'g':
+                run.solver = optarg;
+                break;
+            case 't':
+                run.gravityConfig.theta = std::atof(optarg);
+                break;
+            case 'q':
+                run.gravityConfig.quadrupole = true;
+                break;
+            case 'o':
+                run.gravityConfig.order = std::atoi(optarg);
+                break;
+            case 'e':
+                run.errorSamples = std::atoi(optarg);
+                break;
+            case 'n':
+                run.threads = std::atoi(optarg);
+                break;
+            case 'p':
+                precision = optarg;
+                break;
+            case 'i':
+                run.integrator = optarg;
+                break;
+            case 'c':
+                run.integratorConfig.compensated = true;
+                break;
+            case 'k':
+                run.integratorConfig.regularise = true;
+                break;
+            case 'r':
+                run.integratorConfig.slices = std::atoi(optarg);
+                break;
+            case 'm':
+                run.testMass = std::atof(optarg) * Physics::Mearth;
+                break;
+            case 'a':
+                run.analytic = true;
+                break;
+            case 'x':
+                run.elementsPath = optarg;
+                break;
+            case 'd':
+                run.decimation = std::atoi(optarg);
+                break;
+            case 'z':
+                run.barycentric = true;
+                break;
+            case 'l':
+                run.lossy = true;
+                break;
+            case 'b':
+                benchmark = optarg;
+                break;
+            case '?':
+                printUsage(args[0]);
+                std::exit(EXIT_FAILURE);
+                break;
+            default:
+                break;
+        }
+    }
+    
+    if(!benchmark.empty()) {
+        std::vector<std::string> files(args + optind, args + argc);
+        if(!Benchmark::run(benchmark, files, std::cout)) {
+            std::cerr << "error: unknown benchmark '" << benchmark << "'" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+    
+    if(argc - optind != 1) {
+        printUsage(args[0]);
+        std::exit(EXIT_FAILURE);
+    }
+    run.jsonpath = args[optind];
+    run.integratorConfig.solver = run.solver;
+    run.integratorConfig.gravity = run.gravityConfig;
+    
+    if(precision == Scalar::name<float>()) {
+        return simulate<float>(run);
+    }
+    if(precision == Scalar::name<double>()) {
+        return simulate<double>(run);
+    }
+    if(precision == Scalar::name<long double>()) {
+        return simulate<long double>(run);
+    }
+#ifdef EXO_QUAD
+    if(precision == Scalar::name<__float128>()) {
+        return simulate<__float128>(run);
+    }
+#endif
+    std::cerr << "error: unknown precision '" << precision << "'" << std::endl;
+    std::exit(EXIT_FAILURE);
+}